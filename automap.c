@@ -0,0 +1,224 @@
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "maze.h"
+#include "automap.h"
+
+/* at most a wall on every side of every cell, each its own line */
+#define MAXSEGS (4 * AUTOMAP_TILE * AUTOMAP_TILE)
+
+struct wall {
+	short x1, y1, x2, y2;
+};
+
+int automap_setup(struct automap *m, int nlevels, int xdim, int ydim)
+{
+	int i, words = (xdim * ydim + 63) / 64;
+
+	memset(m, 0, sizeof(*m));
+	m->nlevels = nlevels;
+	m->xdim = xdim;
+	m->ydim = ydim;
+	m->tilesx = (xdim + AUTOMAP_TILE - 1) / AUTOMAP_TILE;
+	m->tilesy = (ydim + AUTOMAP_TILE - 1) / AUTOMAP_TILE;
+	m->explored = calloc(nlevels, sizeof(*m->explored));
+	m->tile = calloc(nlevels * m->tilesx * m->tilesy, sizeof(*m->tile));
+	if (!m->explored || !m->tile)
+		goto fail;
+	for (i = 0; i < nlevels; i++) {
+		m->explored[i] = calloc(words, sizeof(*m->explored[i]));
+		if (!m->explored[i])
+			goto fail;
+	}
+	return 0;
+fail:
+	automap_free(m);
+	return -1;
+}
+
+void automap_free(struct automap *m)
+{
+	int i;
+
+	for (i = 0; m->explored && i < m->nlevels; i++)
+		free(m->explored[i]);
+	for (i = 0; m->tile && i < m->nlevels * m->tilesx * m->tilesy; i++) {
+		free(m->tile[i].line);
+		free(m->tile[i].x);
+		free(m->tile[i].y);
+	}
+	free(m->explored);
+	free(m->tile);
+	memset(m, 0, sizeof(*m));
+}
+
+static inline int open_cell(struct automap *m, char *maze, int x, int y)
+{
+	return inbounds(x, y, m->xdim, m->ydim) && maze[y * m->xdim + x] == '#';
+}
+
+/* Is there wall on side dir of x, y which the player's seen */
+static inline int seen_wall(struct automap *m, char *maze, int level,
+				int x, int y, int dir)
+{
+	return automap_explored(m, level, x, y) && open_cell(m, maze, x, y) &&
+		!open_cell(m, maze, x + xo[dir], y + yo[dir]);
+}
+
+/* Every seen wall in the tile, the walls along each row or column of
+ * cells merged into as few lines as they'll go.
+ */
+static int find_walls(struct automap *m, char *maze, int level,
+			int x1, int y1, int x2, int y2, struct wall *w)
+{
+	int n = 0, x, y, dir, start;
+
+	for (dir = 0; dir < 4; dir += 2) {	/* north and south sides */
+		for (y = y1; y < y2; y++) {
+			for (x = x1; x < x2; x++) {
+				if (!seen_wall(m, maze, level, x, y, dir))
+					continue;
+				for (start = x; x + 1 < x2 &&
+					seen_wall(m, maze, level, x + 1, y, dir); x++)
+					;
+				w[n].x1 = start;
+				w[n].x2 = x + 1;
+				w[n].y1 = w[n].y2 = y + (dir == 2);
+				n++;
+			}
+		}
+	}
+	for (dir = 1; dir < 4; dir += 2) {	/* east and west */
+		for (x = x1; x < x2; x++) {
+			for (y = y1; y < y2; y++) {
+				if (!seen_wall(m, maze, level, x, y, dir))
+					continue;
+				for (start = y; y + 1 < y2 &&
+					seen_wall(m, maze, level, x, y + 1, dir); y++)
+					;
+				w[n].y1 = start;
+				w[n].y2 = y + 1;
+				w[n].x1 = w[n].x2 = x + (dir == 1);
+				n++;
+			}
+		}
+	}
+	return n;
+}
+
+/* Take the unused wall with an end at x, y, setting x, y to its other end */
+static int follow(struct wall *w, int n, char *used, short *x, short *y)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (used[i])
+			continue;
+		if (w[i].x1 == *x && w[i].y1 == *y) {
+			*x = w[i].x2;
+			*y = w[i].y2;
+		} else if (w[i].x2 == *x && w[i].y2 == *y) {
+			*x = w[i].x1;
+			*y = w[i].y1;
+		} else {
+			continue;
+		}
+		used[i] = 1;
+		return 1;
+	}
+	return 0;
+}
+
+static int rebuild(struct automap *m, char *maze, int level, int tx, int ty,
+			struct automap_tile *t)
+{
+	struct wall w[MAXSEGS];
+	char used[MAXSEGS];
+	short px[2 * MAXSEGS + 2], py[2 * MAXSEGS + 2];
+	int i, n, head, tail, x2, y2;
+
+	if (!t->line) {
+		t->line = malloc(sizeof(*t->line) * (MAXSEGS + 1));
+		t->x = malloc(sizeof(*t->x) * 2 * MAXSEGS);
+		t->y = malloc(sizeof(*t->y) * 2 * MAXSEGS);
+		if (!t->line || !t->x || !t->y) {
+			free(t->line);
+			free(t->x);
+			free(t->y);
+			t->line = NULL;
+			return -1;
+		}
+	}
+	x2 = (tx + 1) * AUTOMAP_TILE;
+	y2 = (ty + 1) * AUTOMAP_TILE;
+	n = find_walls(m, maze, level, tx * AUTOMAP_TILE, ty * AUTOMAP_TILE,
+			x2 < m->xdim ? x2 : m->xdim, y2 < m->ydim ? y2 : m->ydim,
+			w);
+	memset(used, 0, n);
+
+	/* chain them, growing each line from both ends out of the middle */
+	t->nlines = 0;
+	t->npoints = 0;
+	for (i = 0; i < n; i++) {
+		if (used[i])
+			continue;
+		used[i] = 1;
+		head = tail = MAXSEGS;
+		px[head] = w[i].x1;
+		py[head] = w[i].y1;
+		px[++tail] = w[i].x2;
+		py[tail] = w[i].y2;
+		px[tail + 1] = px[tail];
+		py[tail + 1] = py[tail];
+		while (follow(w, n, used, &px[tail + 1], &py[tail + 1])) {
+			tail++;
+			px[tail + 1] = px[tail];
+			py[tail + 1] = py[tail];
+		}
+		px[head - 1] = px[head];
+		py[head - 1] = py[head];
+		while (follow(w, n, used, &px[head - 1], &py[head - 1])) {
+			head--;
+			px[head - 1] = px[head];
+			py[head - 1] = py[head];
+		}
+		t->line[t->nlines++] = t->npoints;
+		memcpy(&t->x[t->npoints], &px[head], sizeof(*px) * (tail - head + 1));
+		memcpy(&t->y[t->npoints], &py[head], sizeof(*py) * (tail - head + 1));
+		t->npoints += tail - head + 1;
+	}
+	t->line[t->nlines] = t->npoints;
+	t->dirty = 0;
+	return 0;
+}
+
+struct automap_tile *automap_tile(struct automap *m, char *maze,
+				int level, int tx, int ty)
+{
+	struct automap_tile *t;
+
+	t = &m->tile[(level * m->tilesy + ty) * m->tilesx + tx];
+	if (t->dirty && rebuild(m, maze, level, tx, ty, t))
+		return NULL;
+	return t;
+}
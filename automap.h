@@ -0,0 +1,78 @@
+#ifndef AUTOMAP_H
+#define AUTOMAP_H
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+
+#include <stdint.h>
+
+/* What the player has seen of each level, a bit per cell, and the walls
+ * of what's been seen as polylines ready to draw.  Those are kept a tile
+ * of the level at a time and only redone for tiles with something newly
+ * seen in them, so drawing the map costs the walls, not working them out.
+ * Walls along a row or column are merged into one line, and lines that
+ * meet are joined up, so the laser blanks between as few as it can.
+ */
+#define AUTOMAP_TILE 8		/* cells each way */
+
+struct automap_tile {
+	int dirty;
+	int nlines, npoints;
+	int *line;		/* where each polyline starts in x[], y[] */
+	short *x, *y;		/* cell corners, 0 to xdim, 0 to ydim */
+};
+
+struct automap {
+	int nlevels, xdim, ydim;
+	int tilesx, tilesy;
+	uint64_t **explored;	/* per level, a bit per cell */
+	struct automap_tile *tile;	/* per level, tilesy * tilesx */
+};
+
+extern int automap_setup(struct automap *m, int nlevels, int xdim, int ydim);
+extern void automap_free(struct automap *m);
+
+/* Mark x, y on level seen.  Cheap when it already was. */
+static inline void automap_explore(struct automap *m, int level, int x, int y)
+{
+	int bit = y * m->xdim + x;
+	uint64_t *w = &m->explored[level][bit >> 6];
+
+	if (*w & (1ULL << (bit & 63)))
+		return;
+	*w |= 1ULL << (bit & 63);
+	m->tile[(level * m->tilesy + y / AUTOMAP_TILE) * m->tilesx +
+		x / AUTOMAP_TILE].dirty = 1;
+}
+
+static inline int automap_explored(struct automap *m, int level, int x, int y)
+{
+	int bit = y * m->xdim + x;
+
+	return (m->explored[level][bit >> 6] >> (bit & 63)) & 1;
+}
+
+/* The wall polylines of tile tx, ty of a level, redone first if anything
+ * new in it has been seen since last time.
+ */
+extern struct automap_tile *automap_tile(struct automap *m, char *maze,
+					int level, int tx, int ty);
+
+#endif
@@ -0,0 +1,222 @@
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "batch.h"
+#include "objects.h"
+#include "raycast.h"
+
+/* A player with no skill at all: wander the corridors, take most ladders
+ * down and some up, shoot robots that get close if it has anything to
+ * shoot them with.  Enough to get robots, levels and ladders exercised
+ * the way a person would.
+ */
+struct bot {
+	unsigned int rng;
+};
+
+static void bot_play(struct game *g, struct bot *b)
+{
+	char *maze = g->maze[g->playerlevel];
+	struct ray_hit hit;
+	int x = g->playerx + xo[g->playerdir];
+	int y = g->playery + yo[g->playerdir];
+	int bits = 0;
+
+	if (game_player_on(g, OBJ_DOWN_LADDER) &&
+		randomn(&b->rng, 2) == 0)
+		bits |= REQUEST_BUTTON_ZERO;
+	if (game_player_on(g, OBJ_UP_LADDER) &&
+		randomn(&b->rng, 8) == 0)
+		bits |= REQUEST_BUTTON_ZERO;
+
+	if (grid_ray_cast(&g->objs, g->playerlevel, g->playerx, g->playery,
+			xo[g->playerdir], yo[g->playerdir], 4,
+			1 << OBJ_ROBOT, &hit))
+		bits |= randomn(&b->rng, 4) ? REQUEST_BUTTON_ONE :
+						REQUEST_BUTTON_TWO;
+
+	if (inbounds(x, y, g->xdim, g->ydim) && maze[y * g->xdim + x] == '#' &&
+		randomn(&b->rng, 8) != 0)
+		bits |= REQUEST_FORWARD;
+	else
+		bits |= randomn(&b->rng, 2) ? REQUEST_LEFT : REQUEST_RIGHT;
+	game_set_requested_bits(g, bits);
+}
+
+struct session {
+	unsigned int seed;
+	unsigned long ticks;
+	double seconds;
+	unsigned long player_moves;
+	unsigned long ladders_climbed;
+	int deepest_level;
+	unsigned long robots_killed;
+	unsigned long items_picked_up;
+	unsigned int checksum;
+	int store_errors;
+	int objects_high_water;
+	float fragmentation;
+	int failed;
+};
+
+struct batch {
+	struct game_config *config;
+	struct session *session;
+	int nsessions;
+	unsigned long ticks;
+	int next_session;
+};
+
+static void run_session(struct batch *b, struct session *s)
+{
+	struct game_config c = *b->config;
+	struct snis_object_pool_stats pool_stats;
+	struct game g;
+	struct bot bot;
+	unsigned long i;
+	double t0;
+
+	c.seed = s->seed;
+	c.print_mazes = 0;
+	if (game_setup(&g, &c)) {
+		s->failed = 1;
+		return;
+	}
+	bot.rng = s->seed ^ 0x5bd1e995;
+
+	t0 = monotonic_time();
+	for (i = 0; i < b->ticks; i++) {
+		bot_play(&g, &bot);
+		game_tick(&g);
+	}
+	s->seconds = monotonic_time() - t0;
+
+	s->ticks = g.clock.ticks;
+	s->player_moves = g.player_moves;
+	s->ladders_climbed = g.ladders_climbed;
+	s->deepest_level = g.deepest_level;
+	s->robots_killed = g.robots_killed;
+	s->items_picked_up = g.items_picked_up;
+	s->checksum = game_checksum(&g);
+	s->store_errors = object_store_check(&g.objs);
+	snis_object_pool_stats(g.objs.pool, &pool_stats);
+	s->objects_high_water = pool_stats.high_water;
+	s->fragmentation = snis_object_pool_fragmentation(&pool_stats);
+	game_free(&g);
+}
+
+static void *batch_worker(void *arg)
+{
+	struct batch *b = arg;
+	int i;
+
+	while ((i = __atomic_fetch_add(&b->next_session, 1, __ATOMIC_RELAXED)) <
+			b->nsessions)
+		run_session(b, &b->session[i]);
+	return NULL;
+}
+
+int run_batch(struct game_config *c, int nsessions, int nthreads,
+		unsigned long ticks)
+{
+	struct batch b;
+	pthread_t *thread;
+	struct session *s;
+	unsigned long total_ticks = 0;
+	double t0, elapsed, tps, min_tps = 0.0, sum_tps = 0.0;
+	int i, nstarted, failed = 0;
+
+	if (nthreads <= 0)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads <= 0)
+		nthreads = 1;
+	if (nthreads > nsessions)
+		nthreads = nsessions;
+	if (ticks == 0)
+		ticks = 600UL * c->sim_hz;
+
+	memset(&b, 0, sizeof(b));
+	b.config = c;
+	b.nsessions = nsessions;
+	b.ticks = ticks;
+	b.session = calloc(nsessions, sizeof(*b.session));
+	thread = calloc(nthreads, sizeof(*thread));
+	if (!b.session || !thread) {
+		free(b.session);
+		free(thread);
+		return -1;
+	}
+	for (i = 0; i < nsessions; i++)
+		b.session[i].seed = c->seed + i;
+
+	t0 = monotonic_time();
+	for (nstarted = 0; nstarted < nthreads; nstarted++)
+		if (pthread_create(&thread[nstarted], NULL, batch_worker, &b))
+			break;
+	if (nstarted == 0)
+		batch_worker(&b);	/* no threads to be had, do it all here */
+	for (i = 0; i < nstarted; i++)
+		pthread_join(thread[i], NULL);
+	elapsed = monotonic_time() - t0;
+
+	printf("%7s %10s %9s %11s %7s %7s %7s %7s %7s %7s %5s %9s\n", "game",
+		"seed", "ticks", "ticks/sec", "moves", "climbs", "deepest",
+		"items", "kills", "objects", "frag", "checksum");
+	for (i = 0; i < nsessions; i++) {
+		s = &b.session[i];
+		if (s->failed) {
+			printf("%7d %10u failed to set up\n", i, s->seed);
+			failed++;
+			continue;
+		}
+		tps = s->seconds > 0.0 ? s->ticks / s->seconds : 0.0;
+		printf("%7d %10u %9lu %11.0f %7lu %7lu %7d %7lu %7lu %7d %5.2f %9x\n",
+			i, s->seed, s->ticks, tps, s->player_moves,
+			s->ladders_climbed, s->deepest_level, s->items_picked_up,
+			s->robots_killed, s->objects_high_water, s->fragmentation,
+			s->checksum);
+		if (s->store_errors) {
+			printf("%7d %10u object store has %d inconsistencies\n",
+				i, s->seed, s->store_errors);
+			failed++;
+			continue;
+		}
+		total_ticks += s->ticks;
+		sum_tps += tps;
+		if (min_tps == 0.0 || tps < min_tps)
+			min_tps = tps;
+	}
+	if (failed < nsessions)
+		printf("%d games on %d threads, %lu ticks in %.2f seconds: "
+			"%.0f ticks/sec overall, per game %.0f mean %.0f min\n",
+			nsessions - failed, nstarted ? nstarted : 1, total_ticks,
+			elapsed, total_ticks / elapsed,
+			sum_tps / (nsessions - failed), min_tps);
+
+	free(b.session);
+	free(thread);
+	return failed ? -1 : 0;
+}
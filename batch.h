@@ -0,0 +1,34 @@
+#ifndef BATCH_H
+#define BATCH_H
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+
+#include "game.h"
+
+/* Play nsessions games with robot players, nthreads at a time (0 for one
+ * per cpu), each for ticks ticks (0 for ten minutes of game time), with
+ * seeds counting up from c->seed.  Prints how each went and how fast the
+ * lot ran.  Returns 0, or -1 if any game couldn't be set up.
+ */
+extern int run_batch(struct game_config *c, int nsessions, int nthreads,
+			unsigned long ticks);
+
+#endif
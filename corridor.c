@@ -0,0 +1,109 @@
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "maze.h"
+#include "corridor.h"
+
+static inline int open_cell(struct corridor_runs *c, char *maze, int x, int y)
+{
+	return inbounds(x, y, c->xdim, c->ydim) && maze[y * c->xdim + x] == '#';
+}
+
+/* The run from x, y going dir is one more than the next cell's, if that's
+ * open, so fill each table sweeping the other way.
+ */
+static void fill_run(struct corridor_runs *c, char *maze, int dir)
+{
+	unsigned short *run = c->run[dir];
+	int x, y, nx, ny, i, j;
+
+	for (i = 0; i < c->ydim; i++) {
+		y = yo[dir] > 0 ? c->ydim - 1 - i : i;
+		for (j = 0; j < c->xdim; j++) {
+			x = xo[dir] > 0 ? c->xdim - 1 - j : j;
+			nx = x + xo[dir];
+			ny = y + yo[dir];
+			if (open_cell(c, maze, nx, ny))
+				run[y * c->xdim + x] = run[ny * c->xdim + nx] + 1;
+			else
+				run[y * c->xdim + x] = 0;
+		}
+	}
+}
+
+int corridor_runs_setup(struct corridor_runs *c, char *maze, int xdim, int ydim)
+{
+	int dir;
+
+	memset(c, 0, sizeof(*c));
+	c->xdim = xdim;
+	c->ydim = ydim;
+	for (dir = 0; dir < 4; dir++) {
+		c->run[dir] = malloc(sizeof(*c->run[dir]) * xdim * ydim);
+		if (!c->run[dir]) {
+			corridor_runs_free(c);
+			return -1;
+		}
+		fill_run(c, maze, dir);
+	}
+	return 0;
+}
+
+void corridor_runs_free(struct corridor_runs *c)
+{
+	int dir;
+
+	for (dir = 0; dir < 4; dir++)
+		free(c->run[dir]);
+	memset(c, 0, sizeof(*c));
+}
+
+void corridor_runs_set_cell(struct corridor_runs *c, char *maze,
+				int x, int y, char v)
+{
+	int dir, bx, by, px, py;
+
+	if (!inbounds(x, y, c->xdim, c->ydim))
+		return;
+	maze[y * c->xdim + x] = v;
+
+	/* A cell's own runs don't depend on it, only those of the cells
+	 * looking at it: walk back from it each way, redoing runs until the
+	 * cell before is a wall, beyond which nothing could see it anyway.
+	 */
+	for (dir = 0; dir < 4; dir++) {
+		px = x;
+		py = y;
+		do {
+			bx = px - xo[dir];
+			by = py - yo[dir];
+			if (!inbounds(bx, by, c->xdim, c->ydim))
+				break;
+			c->run[dir][by * c->xdim + bx] =
+				open_cell(c, maze, px, py) ?
+					c->run[dir][py * c->xdim + px] + 1 : 0;
+			px = bx;
+			py = by;
+		} while (open_cell(c, maze, px, py));
+	}
+}
@@ -0,0 +1,69 @@
+#ifndef CORRIDOR_H
+#define CORRIDOR_H
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+
+/* How far you can see from each cell of a maze: run[dir][y * xdim + x] is
+ * how many open cells there are in a row going direction dir (see xo[],
+ * yo[]) from x, y before a wall.  Turns view depth, which walls to draw
+ * and who can see whom into lookups instead of walks down the corridor.
+ */
+struct corridor_runs {
+	int xdim, ydim;
+	unsigned short *run[4];
+};
+
+extern int corridor_runs_setup(struct corridor_runs *c, char *maze,
+				int xdim, int ydim);
+extern void corridor_runs_free(struct corridor_runs *c);
+
+/* Set maze cell x, y to v ('#' open, '.' wall) and fix up the runs
+ * through it, which only touches the cells that can see it.
+ */
+extern void corridor_runs_set_cell(struct corridor_runs *c, char *maze,
+				int x, int y, char v);
+
+static inline int corridor_run(struct corridor_runs *c, int x, int y, int dir)
+{
+	return c->run[dir][y * c->xdim + x];
+}
+
+/* Which way to look from x, y to see tx, ty, or -1 if there's a wall in
+ * the way or they're not in a straight line.
+ */
+static inline int corridor_sees(struct corridor_runs *c, int x, int y,
+				int tx, int ty)
+{
+	int dir, d;
+
+	if (x == tx && y != ty) {
+		dir = ty < y ? 0 : 2;
+		d = ty < y ? y - ty : ty - y;
+	} else if (y == ty && x != tx) {
+		dir = tx > x ? 1 : 3;
+		d = tx > x ? tx - x : x - tx;
+	} else {
+		return -1;
+	}
+	return d <= corridor_run(c, x, y, dir) ? dir : -1;
+}
+
+#endif
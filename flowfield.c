@@ -0,0 +1,243 @@
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "maze.h"
+#include "flowfield.h"
+
+int flow_field_setup(struct flow_field *f, int xdim, int ydim, int radius)
+{
+	memset(f, 0, sizeof(*f));
+	f->dist = malloc(sizeof(*f->dist) * xdim * ydim);
+	f->queue = malloc(sizeof(*f->queue) * xdim * ydim);
+	if (!f->dist || !f->queue) {
+		free(f->dist);
+		free(f->queue);
+		return -1;
+	}
+	memset(f->dist, 0xff, sizeof(*f->dist) * xdim * ydim);
+	f->xdim = xdim;
+	f->ydim = ydim;
+	f->radius = radius < FLOW_FIELD_FAR ? radius : FLOW_FIELD_FAR - 1;
+	f->tx = -1;
+	f->ty = -1;
+	return 0;
+}
+
+void flow_field_free(struct flow_field *f)
+{
+	free(f->dist);
+	free(f->queue);
+	memset(f, 0, sizeof(*f));
+}
+
+void flow_field_clear(struct flow_field *f)
+{
+	int i;
+
+	/* only what the last search reached has anything to forget */
+	for (i = 0; i < f->nreached; i++)
+		f->dist[f->queue[i]] = FLOW_FIELD_FAR;
+	f->nreached = 0;
+	f->tx = -1;
+	f->ty = -1;
+}
+
+int flow_field_update(struct flow_field *f, char *maze, int tx, int ty)
+{
+	unsigned short *dist = f->dist;
+	int *queue = f->queue;
+	int head, tail, cell, x, y, nx, ny, n, d, dir;
+
+	if (tx == f->tx && ty == f->ty)
+		return 0;
+	flow_field_clear(f);
+	f->tx = tx;
+	f->ty = ty;
+	if (!inbounds(tx, ty, f->xdim, f->ydim))
+		return 1;
+
+	head = 0;
+	tail = 0;
+	cell = ty * f->xdim + tx;
+	dist[cell] = 0;
+	queue[tail++] = cell;
+	while (head < tail) {
+		cell = queue[head++];
+		d = dist[cell];
+		if (d >= f->radius)
+			continue;
+		x = cell % f->xdim;
+		y = cell / f->xdim;
+		for (dir = 0; dir < 4; dir++) {
+			nx = x + xo[dir];
+			ny = y + yo[dir];
+			if (!inbounds(nx, ny, f->xdim, f->ydim))
+				continue;
+			n = ny * f->xdim + nx;
+			if (maze[n] != '#' || dist[n] != FLOW_FIELD_FAR)
+				continue;
+			dist[n] = d + 1;
+			queue[tail++] = n;
+		}
+	}
+	f->nreached = tail;
+	return 1;
+}
+
+int flow_field_downhill(struct flow_field *f, int x, int y, int dir)
+{
+	int d, nx, ny, i, try;
+
+	d = f->dist[y * f->xdim + x];
+	if (d == 0 || d == FLOW_FIELD_FAR)
+		return -1;
+	for (i = 0; i < 4; i++) {
+		try = (dir + i) & 3;
+		nx = x + xo[try];
+		ny = y + yo[try];
+		if (inbounds(nx, ny, f->xdim, f->ydim) &&
+			f->dist[ny * f->xdim + nx] < d)
+			return try;
+	}
+	return -1;
+}
+
+#ifdef FLOWFIELD_BENCHMARK
+/* Field update cost versus level size, with the player wandering the
+ * corridors one cell at a time as in the game: "whole" searches the whole
+ * level on every move, "radius" only out to the range robots hunt from,
+ * which is what the game does.  "per-robot" is what a search per robot
+ * per step would cost with 500 robots on the level, and "downhill" what
+ * a robot's step costs given the field.
+ */
+#include <time.h>
+
+#include "my_point.h"
+
+#define MOVES 2000
+#define ROBOTS 500
+#define HUNT_RADIUS 24
+
+static unsigned int bench_rng = 1234;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* walk the target through the corridors, updating the field each move */
+static double walk(struct flow_field *f, char *maze, int xdim, int ydim)
+{
+	int i, x, y, nx, ny, dir = 0;
+	double t0;
+
+	x = xdim / 2;
+	y = ydim - 2;
+	t0 = now();
+	for (i = 0; i < MOVES; i++) {
+		nx = x + xo[dir];
+		ny = y + yo[dir];
+		if (!inbounds(nx, ny, xdim, ydim) || maze[ny * xdim + nx] != '#' ||
+			randomn(&bench_rng, 8) == 0) {
+			dir = randomn(&bench_rng, 4);
+			i--;
+			continue;
+		}
+		x = nx;
+		y = ny;
+		flow_field_update(f, maze, x, y);
+	}
+	return now() - t0;
+}
+
+static double downhill(struct flow_field *f, char *maze, int xdim, int ydim)
+{
+	int i, r, x[ROBOTS], y[ROBOTS], dir, steps = 0;
+	double t0, t;
+
+	/* robots scattered within range of the target */
+	for (r = 0; r < ROBOTS; r++) {
+		do {
+			x[r] = randomn(&bench_rng, xdim);
+			y[r] = randomn(&bench_rng, ydim);
+		} while (maze[y[r] * xdim + x[r]] != '#');
+	}
+	t0 = now();
+	for (i = 0; i < MOVES; i++) {
+		for (r = 0; r < ROBOTS; r++) {
+			dir = flow_field_downhill(f, x[r], y[r], 0);
+			if (dir < 0)
+				continue;
+			x[r] += xo[dir];
+			y[r] += yo[dir];
+		}
+		steps += ROBOTS;
+	}
+	t = now() - t0;
+	return t / steps;
+}
+
+static void bench_size(int xdim, int ydim)
+{
+	struct flow_field whole, radius;
+	char *maze;
+	double twhole, tradius, tstep;
+
+	maze = make_maze(xdim, ydim, xdim / 2, ydim - 2, 0, &bench_rng);
+	flow_field_setup(&whole, xdim, ydim, FLOW_FIELD_FAR);
+	flow_field_setup(&radius, xdim, ydim, HUNT_RADIUS);
+
+	twhole = walk(&whole, maze, xdim, ydim);
+	tradius = walk(&radius, maze, xdim, ydim);
+	tstep = downhill(&whole, maze, xdim, ydim);
+
+	printf("%5dx%-5d %9d %9d %12.2f %12.2f %15.1f %12.1f\n", xdim, ydim,
+		xdim * ydim, whole.nreached, twhole * 1e6 / MOVES,
+		tradius * 1e6 / MOVES, twhole * 1e3 / MOVES * ROBOTS,
+		tstep * 1e9);
+
+	flow_field_free(&whole);
+	flow_field_free(&radius);
+	free(maze);
+}
+
+int main(__attribute__((unused)) int argc, __attribute__((unused)) char *argv[])
+{
+	int size[][2] = {
+		{ XDIM, YDIM }, { 2 * XDIM, 2 * YDIM }, { 4 * XDIM, 4 * YDIM },
+		{ 8 * XDIM, 8 * YDIM }, { 16 * XDIM, 16 * YDIM },
+	};
+	unsigned int i;
+
+	printf("%11s %9s %9s %12s %12s %15s %12s\n", "level", "cells",
+		"corridor", "whole us/mv", "radius us/mv", "per-robot ms/mv",
+		"downhill ns");
+	for (i = 0; i < ARRAY_SIZE(size); i++)
+		bench_size(size[i][0], size[i][1]);
+	return 0;
+}
+#endif
@@ -0,0 +1,67 @@
+#ifndef FLOWFIELD_H
+#define FLOWFIELD_H
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+
+/* A breadth first distance field over a maze's corridors toward one
+ * target cell, shared by everything on the level that wants to get
+ * there: each chaser just steps to whichever neighbour is nearer, so the
+ * cost of pathfinding is one search per target move rather than one per
+ * chaser per step.
+ *
+ * Distances are only worked out to within radius steps of the target;
+ * anything further out reads as FLOW_FIELD_FAR.  Recomputing then costs
+ * the cells within radius, not the whole maze, however big it gets.
+ */
+#define FLOW_FIELD_FAR 0xffff
+
+struct flow_field {
+	int xdim, ydim;
+	int radius;
+	int tx, ty;		/* target cell, -1, -1 if there isn't one */
+	int nreached;		/* cells in queue[] which have distances */
+	unsigned short *dist;	/* xdim * ydim, steps to the target */
+	int *queue;		/* cells reached, nearest first */
+};
+
+extern int flow_field_setup(struct flow_field *f, int xdim, int ydim, int radius);
+extern void flow_field_free(struct flow_field *f);
+
+/* Lead the field to tx, ty.  Only searches if the target has actually
+ * changed cell, returns 1 if it did, 0 if the field was already good.
+ */
+extern int flow_field_update(struct flow_field *f, char *maze, int tx, int ty);
+
+/* Forget the target, everything reads as FLOW_FIELD_FAR */
+extern void flow_field_clear(struct flow_field *f);
+
+static inline int flow_field_distance(struct flow_field *f, int x, int y)
+{
+	return f->dist[y * f->xdim + x];
+}
+
+/* Which way is downhill from x, y: direction (see xo[], yo[]) to a
+ * neighbour nearer the target, preferring to carry on in direction dir,
+ * or -1 if x, y is the target or out of range of it.
+ */
+extern int flow_field_downhill(struct flow_field *f, int x, int y, int dir);
+
+#endif
@@ -0,0 +1,337 @@
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+#include <ctype.h>
+#include <string.h>
+
+#include "font.h"
+
+/* Glyphs are drawn through these points, one letter each:
+ *
+ *	a b c
+ *	d e f
+ *	g h i
+ *	j k l
+ *	m n o
+ *
+ * a stroke to a run of letters, strokes split by spaces, and a stroke of
+ * one letter a dot.
+ */
+#define GRID_WIDTH 3
+#define ADVANCE 3		/* grid steps from one glyph to the next */
+#define HEIGHT 4
+#define MAX_STROKES 6
+#define MAX_GLYPH_POINTS 12
+
+static const char *glyph_strokes[128] = {
+	['0'] = "acoma mc",
+	['1'] = "dbn mo",
+	['2'] = "acigmo",
+	['3'] = "acom gi",
+	['4'] = "agi co",
+	['5'] = "cagiom",
+	['6'] = "camoig",
+	['7'] = "aco",
+	['8'] = "acoma gi",
+	['9'] = "igacom",
+	['A'] = "maco gi",
+	['B'] = "mabfhlnm gh",
+	['C'] = "camo",
+	['D'] = "mabflnm",
+	['E'] = "camo gh",
+	['F'] = "cam gh",
+	['G'] = "camoih",
+	['H'] = "am co gi",
+	['I'] = "ac bn mo",
+	['J'] = "comj",
+	['K'] = "am gc go",
+	['L'] = "amo",
+	['M'] = "maeco",
+	['N'] = "maoc",
+	['O'] = "acoma",
+	['P'] = "macig",
+	['Q'] = "acoma ko",
+	['R'] = "macig go",
+	['S'] = "cagiom",
+	['T'] = "ac bn",
+	['U'] = "amoc",
+	['V'] = "anc",
+	['W'] = "amhoc",
+	['X'] = "ao cm",
+	['Y'] = "ahc hn",
+	['Z'] = "acmo",
+	[':'] = "e k",
+	['-'] = "gi",
+	['/'] = "mc",
+	['.'] = "n",
+};
+
+static struct glyph {
+	int nstrokes;
+	int stroke[MAX_STROKES + 1];	/* where each starts in x[], y[] */
+	signed char x[MAX_GLYPH_POINTS], y[MAX_GLYPH_POINTS];
+} glyph[128];
+
+static inline int sq(int x)
+{
+	return x * x;
+}
+
+/* Put the strokes of one glyph in order, each starting from whichever of
+ * its ends is nearest where the last one finished, the first from near
+ * the left edge, where the glyph before will have left off.
+ */
+static void parse_glyph(const char *desc, struct glyph *g)
+{
+	const char *stroke[MAX_STROKES], *s;
+	int len[MAX_STROKES], n = 0, i, best, bestd, d, rev, penx, peny;
+	int x1, y1, x2, y2, j, k;
+
+	memset(g, 0, sizeof(*g));
+	for (s = desc; *s; ) {
+		while (*s == ' ')
+			s++;
+		if (!*s)
+			break;
+		stroke[n] = s;
+		while (*s && *s != ' ')
+			s++;
+		len[n] = s - stroke[n];
+		n++;
+	}
+
+	penx = -1;
+	peny = HEIGHT / 2;
+	k = 0;
+	for (g->nstrokes = 0; g->nstrokes < n; g->nstrokes++) {
+		best = -1;
+		bestd = 0;
+		rev = 0;
+		for (i = 0; i < n; i++) {
+			if (!stroke[i])
+				continue;
+			x1 = (stroke[i][0] - 'a') % GRID_WIDTH;
+			y1 = (stroke[i][0] - 'a') / GRID_WIDTH;
+			x2 = (stroke[i][len[i] - 1] - 'a') % GRID_WIDTH;
+			y2 = (stroke[i][len[i] - 1] - 'a') / GRID_WIDTH;
+			d = sq(x1 - penx) + sq(y1 - peny);
+			if (best < 0 || d < bestd) {
+				best = i;
+				bestd = d;
+				rev = 0;
+			}
+			d = sq(x2 - penx) + sq(y2 - peny);
+			if (d < bestd) {
+				best = i;
+				bestd = d;
+				rev = 1;
+			}
+		}
+		g->stroke[g->nstrokes] = k;
+		for (j = 0; j < len[best]; j++) {
+			i = stroke[best][rev ? len[best] - 1 - j : j] - 'a';
+			g->x[k] = i % GRID_WIDTH;
+			g->y[k] = i / GRID_WIDTH;
+			k++;
+		}
+		penx = g->x[k - 1];
+		peny = g->y[k - 1];
+		stroke[best] = NULL;
+	}
+	g->stroke[g->nstrokes] = k;
+}
+
+void font_setup(void)
+{
+	int i;
+
+	for (i = 0; i < 128; i++)
+		if (glyph_strokes[i])
+			parse_glyph(glyph_strokes[i], &glyph[i]);
+}
+
+void font_cache_init(struct font_cache *c)
+{
+	memset(c, 0, sizeof(*c));
+}
+
+static void layout(struct font_text *t, const char *text, float scale)
+{
+	struct glyph *g;
+	int i, s, j, x, y, ox = 0;
+
+	strncpy(t->text, text, FONT_MAX_TEXT - 1);
+	t->text[FONT_MAX_TEXT - 1] = '\0';
+	t->scale = scale;
+	t->nlines = 0;
+	t->npoints = 0;
+	for (i = 0; t->text[i]; i++, ox += ADVANCE) {
+		g = &glyph[toupper(t->text[i]) & 0x7f];
+		for (s = 0; s < g->nstrokes; s++) {
+			j = g->stroke[s];
+			x = (ox + g->x[j]) * scale;
+			y = g->y[j] * scale;
+			/* carry on from where the last stroke left off if it can */
+			if (!t->npoints || x != t->x[t->npoints - 1] ||
+				y != t->y[t->npoints - 1] ||
+				g->stroke[s + 1] - j == 1)
+				t->line[t->nlines++] = t->npoints;
+			else
+				j++;
+			for (; j < g->stroke[s + 1]; j++) {
+				t->x[t->npoints] = (ox + g->x[j]) * scale;
+				t->y[t->npoints] = g->y[j] * scale;
+				t->npoints++;
+			}
+		}
+	}
+	t->line[t->nlines] = t->npoints;
+	t->width = (i ? ADVANCE * i - (ADVANCE - GRID_WIDTH + 1) : 0) * scale;
+	t->height = HEIGHT * scale;
+}
+
+struct font_text *font_layout(struct font_cache *c, const char *text,
+				float scale)
+{
+	struct font_text *t, *oldest = &c->text[0];
+	int i;
+
+	c->clock++;
+	for (i = 0; i < FONT_CACHE_SIZE; i++) {
+		t = &c->text[i];
+		if (t->used && t->scale == scale &&
+			strncmp(t->text, text, FONT_MAX_TEXT - 1) == 0) {
+			t->used = c->clock;
+			c->hits++;
+			return t;
+		}
+		if (t->used < oldest->used)
+			oldest = t;
+	}
+	layout(oldest, text, scale);
+	oldest->used = c->clock;
+	c->misses++;
+	return oldest;
+}
+
+#ifdef FONT_BENCHMARK
+/* Cost of a HUD's worth of strings laid out every frame against getting
+ * them from the cache, and how far the laser travels blanked drawing them
+ * with strokes in the order they're described against the order they're
+ * put in.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define FRAMES 100000
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static const char *hud[] = { "LEVEL 3", "KILLS 127", "0123456789",
+				"THE QUICK BROWN FOX", "JUMPS OVER THE LAZY DOG" };
+
+/* blanked travel between polylines, in grid steps */
+static float blanked(struct font_text *t)
+{
+	float d = 0.0;
+	int i, j;
+
+	for (i = 1; i < t->nlines; i++) {
+		j = t->line[i];
+		d += (abs(t->x[j] - t->x[j - 1]) + abs(t->y[j] - t->y[j - 1])) /
+			t->scale;
+	}
+	return d;
+}
+
+static void as_written(const char *desc, struct glyph *g)
+{
+	int k = 0;
+
+	memset(g, 0, sizeof(*g));
+	for (; *desc; desc++) {
+		if (*desc == ' ') {
+			g->stroke[++g->nstrokes] = k;
+			continue;
+		}
+		g->x[k] = (*desc - 'a') % GRID_WIDTH;
+		g->y[k] = (*desc - 'a') / GRID_WIDTH;
+		k++;
+	}
+	g->stroke[++g->nstrokes] = k;
+}
+
+int main(__attribute__((unused)) int argc, __attribute__((unused)) char *argv[])
+{
+	static struct font_cache c;
+	static struct font_text t;
+	struct glyph ordered[128];
+	double t0, tlayout, tcached;
+	float before[5], after[5];
+	int lines[2][5];
+	unsigned int i, f;
+
+	font_setup();
+	memcpy(ordered, glyph, sizeof(glyph));
+	for (i = 0; i < 5; i++) {
+		layout(&t, hud[i], 1.0);
+		after[i] = blanked(&t);
+		lines[1][i] = t.nlines;
+	}
+	/* strokes as written, for comparison */
+	for (i = 0; i < 128; i++)
+		if (glyph_strokes[i])
+			as_written(glyph_strokes[i], &glyph[i]);
+	for (i = 0; i < 5; i++) {
+		layout(&t, hud[i], 1.0);
+		before[i] = blanked(&t);
+		lines[0][i] = t.nlines;
+	}
+	memcpy(glyph, ordered, sizeof(glyph));
+
+	t0 = now();
+	for (f = 0; f < FRAMES; f++)
+		for (i = 0; i < 2; i++)
+			layout(&t, hud[i], 8.0);
+	tlayout = now() - t0;
+	font_cache_init(&c);
+	t0 = now();
+	for (f = 0; f < FRAMES; f++)
+		for (i = 0; i < 2; i++)
+			font_layout(&c, hud[i], 8.0);
+	tcached = now() - t0;
+
+	printf("%-24s %12s %12s\n", "", "as written", "ordered");
+	for (i = 0; i < 5; i++)
+		printf("%-24s %5d %6.1f %5d %6.1f   lines, blanked steps\n",
+			hud[i], lines[0][i], before[i], lines[1][i], after[i]);
+	printf("two HUD strings a frame: %.2f us laid out, %.3f us cached "
+		"(%d hits, %d misses)\n", tlayout * 1e6 / FRAMES,
+		tcached * 1e6 / FRAMES, c.hits, c.misses);
+	return 0;
+}
+#endif
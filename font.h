@@ -0,0 +1,65 @@
+#ifndef FONT_H
+#define FONT_H
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+
+/* A vector font for the laser.  Glyphs are strokes on a 3 by 5 grid,
+ * worked out from their descriptions once, in an order that has the
+ * laser blank between them as little as it can, and whole strings are
+ * laid out into polylines ready to draw and kept, keyed by text and
+ * scale, so text that hasn't changed since the last frame costs nothing
+ * but drawing.  Coordinates are screen units from the top left of the
+ * text.
+ */
+#define FONT_MAX_TEXT 32	/* longest string laid out, less one */
+#define FONT_MAX_POINTS (FONT_MAX_TEXT * 12)
+#define FONT_CACHE_SIZE 16
+
+struct font_text {
+	char text[FONT_MAX_TEXT];
+	float scale;
+	unsigned long used;	/* when it was last asked for */
+	int width, height;
+	int nlines, npoints;
+	int line[FONT_MAX_POINTS + 1];	/* where each polyline starts */
+	short x[FONT_MAX_POINTS], y[FONT_MAX_POINTS];
+};
+
+struct font_cache {
+	unsigned long clock;
+	int hits, misses;
+	struct font_text text[FONT_CACHE_SIZE];
+};
+
+/* Parse the glyphs, once, before laying anything out */
+extern void font_setup(void);
+
+extern void font_cache_init(struct font_cache *c);
+
+/* text laid out at scale screen units per grid step, from the cache or
+ * done now and cached in place of whatever was used longest ago.
+ * Characters there's no glyph for come out as spaces, and anything past
+ * FONT_MAX_TEXT - 1 characters is left off.
+ */
+extern struct font_text *font_layout(struct font_cache *c, const char *text,
+					float scale);
+
+#endif
@@ -0,0 +1,454 @@
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "my_point.h"
+#include "game.h"
+#include "raycast.h"
+
+#define PLAYER_MOVE_TIME (0.25) /* seconds between player steps */
+#define ROBOT_MOVE_TIME_MIN (0.66) /* seconds a robot takes over a step */
+#define ROBOT_MOVE_TIME_MAX (1.5)
+#define LASER_RANGE 20		/* cells */
+#define GRENADE_RANGE 4		/* how far a grenade can be thrown */
+#define GRENADE_RADIUS 2
+#define EXPLORE_DEPTH 8		/* how far down a corridor the player can see */
+
+void game_default_config(struct game_config *c)
+{
+	memset(c, 0, sizeof(*c));
+	c->seed = 1;
+	c->sim_hz = DEFAULT_SIM_HZ;
+	c->lod.mode = SIM_LOD_BATCHED;
+	c->lod.batch_interval = 5.0;
+	c->lod.max_catchup_moves = 20;
+	c->nrobots = 20;
+	c->nfirstaidkits = 20;
+	c->nlaserpistols = 3;
+	c->ngrenades = 3;
+	c->maxobjs = DEFAULT_MAXOBJS;
+}
+
+int game_player_on(struct game *g, enum object_type type)
+{
+	struct level *l = &g->objs.level[g->playerlevel];
+
+	if (!object_store_occupied(l, object_type_class[type],
+					g->playerx, g->playery))
+		return 0;
+	return object_store_find_in_cell(&g->objs, g->playerlevel,
+				g->playerx, g->playery, 1 << type) >= 0;
+}
+
+#define ITEM_TYPES ((1 << OBJ_FIRSTAIDKIT) | (1 << OBJ_LASERPISTOL) | \
+			(1 << OBJ_GRENADE))
+
+static void pick_up_items(struct game *g)
+{
+	struct level *l = &g->objs.level[g->playerlevel];
+	int n;
+
+	if (!object_store_occupied(l, CLASS_ITEM, g->playerx, g->playery))
+		return;
+	while ((n = object_store_find_in_cell(&g->objs, g->playerlevel,
+				g->playerx, g->playery, ITEM_TYPES)) >= 0) {
+		switch (object_store_slot(&g->objs, n)->type) {
+		case OBJ_FIRSTAIDKIT:
+			g->firstaidkits++;
+			break;
+		case OBJ_LASERPISTOL:
+			g->laserpistols++;
+			break;
+		case OBJ_GRENADE:
+			g->grenades++;
+			break;
+		}
+		object_store_remove(&g->objs, n);
+		g->items_picked_up++;
+	}
+}
+
+static int climb_ladder(struct game *g)
+{
+	g->requested_button_zero = 0;
+	if (game_player_on(g, OBJ_UP_LADDER)) {
+		if (g->playerlevel > 0) {
+			g->playerlevel--;
+			object_store_set_active_level(&g->objs, g->playerlevel);
+			return 1;
+		}
+	}
+	if (game_player_on(g, OBJ_DOWN_LADDER)) {
+		if (g->playerlevel < MAXLEVELS - 1) {
+			g->playerlevel++;
+			object_store_set_active_level(&g->objs, g->playerlevel);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Mark what the player can see from here as explored */
+static void explore(struct game *g)
+{
+	struct corridor_runs *c = &g->objs.level[g->playerlevel].runs;
+	int x = g->playerx, y = g->playery, dir = g->playerdir;
+	int i, n = corridor_run(c, x, y, dir);
+
+	if (n > EXPLORE_DEPTH)
+		n = EXPLORE_DEPTH;
+	for (i = 0; i <= n; i++)
+		automap_explore(&g->map, g->playerlevel,
+				x + i * xo[dir], y + i * yo[dir]);
+}
+
+static int move_player(struct game *g)
+{
+	struct level *l = &g->objs.level[g->playerlevel];
+	char *maze = g->maze[g->playerlevel];
+	int xdim = g->xdim;
+	int ydim = g->ydim;
+	int nx, ny, nd, tx, ty;
+	int dir, climbed = GAME_TICK_IDLE;
+
+	nx = g->playerx;
+	ny = g->playery;
+	nd = g->playerdir;
+
+	if (g->clock.ticks - g->last_move_tick < g->player_move_ticks)
+		return g->requested_forward || g->requested_backward ||
+			g->requested_left || g->requested_right ||
+			g->requested_button_zero ?
+				GAME_TICK_WAITING : GAME_TICK_IDLE;
+
+	if (g->requested_forward) {
+		tx = g->playerx + xo[g->playerdir];
+		ty = g->playery + yo[g->playerdir];
+		if (!inbounds_for_digging(tx, ty, xdim, ydim))
+			return GAME_TICK_IDLE;
+		if (maze[ty * xdim + tx] == '#' &&
+			!object_store_occupied(l, CLASS_ROBOT, tx, ty)) {
+			nx = tx;
+			ny = ty;
+		}
+	}
+
+	if (g->requested_backward) {
+		dir = g->playerdir + 2;
+		if (dir > 3)
+			dir -= 4;
+		tx = g->playerx + xo[dir];
+		ty = g->playery + yo[dir];
+		if (!inbounds_for_digging(tx, ty, xdim, ydim))
+			return GAME_TICK_IDLE;
+		if (maze[ty * xdim + tx] == '#' &&
+			!object_store_occupied(l, CLASS_ROBOT, tx, ty)) {
+			nx = tx;
+			ny = ty;
+		}
+	}
+
+	if (g->requested_left) {
+		nd = g->playerdir - 1;
+		if (nd < 0)
+			nd = 3;
+	}
+
+	if (g->requested_right) {
+		nd = g->playerdir + 1;
+		if (nd > 3)
+			nd = 0;
+	}
+
+	if (g->requested_button_zero && climb_ladder(g)) {
+		g->ladders_climbed++;
+		if (g->playerlevel > g->deepest_level)
+			g->deepest_level = g->playerlevel;
+		pick_up_items(g);
+		explore(g);
+		climbed = GAME_TICK_MOVED;
+	}
+
+	if (nx != g->playerx || ny != g->playery || nd != g->playerdir) {
+		g->playerx = nx;
+		g->playery = ny;
+		g->playerdir = nd;
+		g->last_move_tick = g->clock.ticks;
+		g->player_moves++;
+		pick_up_items(g);
+		explore(g);
+#if 0
+		/* activate this to debug player movement */
+		print_maze(maze, xdim, ydim, g->playerx, g->playery, g->playerdir);
+#endif
+		return GAME_TICK_MOVED;
+	}
+	return climbed;
+}
+
+/* Past MAX_EFFECTS, or with nobody taking them, they just get dropped */
+static void add_effect(struct game *g, enum game_effect_type type, int x, int y)
+{
+	struct game_effect *e;
+
+	if (g->neffects >= MAX_EFFECTS)
+		return;
+	e = &g->effect[g->neffects++];
+	e->type = type;
+	e->level = g->playerlevel;
+	e->x = x;
+	e->y = y;
+}
+
+static void kill_robot(struct game *g, int n)
+{
+	object_store_remove(&g->objs, n);
+	g->robots_killed++;
+}
+
+static void fire_laser(struct game *g)
+{
+	struct ray_hit hit;
+
+	g->requested_button_one = 0;
+	if (grid_ray_cast(&g->objs, g->playerlevel, g->playerx, g->playery,
+			xo[g->playerdir], yo[g->playerdir], LASER_RANGE,
+			1 << OBJ_ROBOT, &hit))
+		kill_robot(g, hit.n);
+	add_effect(g, EFFECT_LASER_HIT, hit.x, hit.y);
+}
+
+/* A grenade flies until it hits a robot or a wall, or runs out of range,
+ * and goes off there.
+ */
+static void throw_grenade(struct game *g)
+{
+	struct ray_hit hit;
+	int n[32], i, count;
+
+	g->requested_button_two = 0;
+	grid_ray_cast(&g->objs, g->playerlevel, g->playerx, g->playery,
+			xo[g->playerdir], yo[g->playerdir], GRENADE_RANGE,
+			1 << OBJ_ROBOT, &hit);
+	add_effect(g, EFFECT_BLAST, hit.x, hit.y);
+	do {
+		count = grid_area_query(&g->objs, g->playerlevel, hit.x, hit.y,
+				GRENADE_RADIUS, 1 << OBJ_ROBOT, n, ARRAY_SIZE(n));
+		for (i = 0; i < count && i < (int) ARRAY_SIZE(n); i++)
+			kill_robot(g, n[i]);
+	} while (count > (int) ARRAY_SIZE(n));
+}
+
+int game_tick(struct game *g)
+{
+	int moved;
+
+	moved = move_player(g);
+	if (g->requested_button_one)
+		fire_laser(g);
+	if (g->requested_button_two)
+		throw_grenade(g);
+	object_store_set_target(&g->objs, g->playerlevel, g->playerx, g->playery);
+	object_store_move_objects(&g->objs, g->clock.tick);
+	g->clock.ticks++;
+	return moved;
+}
+
+int game_requested_bits(struct game *g)
+{
+	return (g->requested_forward ? REQUEST_FORWARD : 0) |
+		(g->requested_backward ? REQUEST_BACKWARD : 0) |
+		(g->requested_left ? REQUEST_LEFT : 0) |
+		(g->requested_right ? REQUEST_RIGHT : 0) |
+		(g->requested_button_zero ? REQUEST_BUTTON_ZERO : 0) |
+		(g->requested_button_one ? REQUEST_BUTTON_ONE : 0) |
+		(g->requested_button_two ? REQUEST_BUTTON_TWO : 0);
+}
+
+void game_set_requested_bits(struct game *g, int bits)
+{
+	g->requested_forward = !!(bits & REQUEST_FORWARD);
+	g->requested_backward = !!(bits & REQUEST_BACKWARD);
+	g->requested_left = !!(bits & REQUEST_LEFT);
+	g->requested_right = !!(bits & REQUEST_RIGHT);
+	g->requested_button_zero = !!(bits & REQUEST_BUTTON_ZERO);
+	g->requested_button_one = !!(bits & REQUEST_BUTTON_ONE);
+	g->requested_button_two = !!(bits & REQUEST_BUTTON_TWO);
+}
+
+static int spawn_object(struct game *g, int level, enum object_type type)
+{
+	char *maze = g->maze[level];
+	int x, y;
+
+	do {
+		x = randomn(&g->rng, g->xdim);
+		y = randomn(&g->rng, g->ydim);
+	} while (maze[g->xdim * y + x] != '#');
+	return object_store_add(&g->objs, level, type, x, y);
+}
+
+static int spawn_objects(struct game *g, int level, enum object_type type, int n)
+{
+	int i, o;
+
+	for (i = 0; i < n; i++) {
+		o = spawn_object(g, level, type);
+		if (o < 0)
+			return -1;
+		/* robots are anything from half again as fast to half as slow */
+		if (type == OBJ_ROBOT)
+			object_store_set_speed(&g->objs, o,
+				ROBOT_MOVE_TIME_MIN + randomn(&g->rng, 100) *
+				(ROBOT_MOVE_TIME_MAX - ROBOT_MOVE_TIME_MIN) / 100.0);
+	}
+	return 0;
+}
+
+static int add_ladders(struct game *g, int lowerlevel)
+{
+	char *uppermaze = g->maze[lowerlevel - 1];
+	char *lowermaze = g->maze[lowerlevel];
+	int xdim = g->xdim;
+	int ydim = g->ydim;
+	int i, x, y;
+
+	for (i = 0; i < LADDERS_BETWEEN_LEVELS; i++) {
+		do {
+			x = randomn(&g->rng, xdim);
+			y = randomn(&g->rng, ydim);
+		} while (uppermaze[xdim * y + x] != '#' ||
+			lowermaze[xdim * y + x] != '#');
+
+		if (object_store_find_in_cell(&g->objs, lowerlevel, x, y, ~0u) >= 0 ||
+			object_store_find_in_cell(&g->objs, lowerlevel - 1,
+							x, y, ~0u) >= 0)
+			continue;
+		if (object_store_add(&g->objs, lowerlevel, OBJ_UP_LADDER, x, y) < 0 ||
+			object_store_add(&g->objs, lowerlevel - 1,
+					OBJ_DOWN_LADDER, x, y) < 0 ||
+			ladder_graph_add_ladder(&g->ladders, lowerlevel, x, y))
+			return -1;
+	}
+	return 0;
+}
+
+int game_setup(struct game *g, struct game_config *c)
+{
+	int i;
+
+	memset(g, 0, sizeof(*g));
+	if (object_store_setup(&g->objs, MAXLEVELS, c->maxobjs)) {
+		fprintf(stderr, "Out of memory for %d objects\n", c->maxobjs);
+		return -1;
+	}
+	if (ladder_graph_setup(&g->ladders, MAXLEVELS, XDIM, YDIM) ||
+		automap_setup(&g->map, MAXLEVELS, XDIM, YDIM)) {
+		fprintf(stderr, "Out of memory for levels\n");
+		game_free(g);
+		return -1;
+	}
+	g->rng = c->seed;
+	g->objs.rng = c->seed ^ 0x9e3779b9;
+	g->xdim = XDIM;
+	g->ydim = YDIM;
+	g->playerx = g->xdim / 2;
+	g->playery = g->ydim - 2;
+	g->playerdir = 0;
+	g->playerlevel = 0;
+
+	for (i = 0; i < MAXLEVELS; i++) {
+		g->maze[i] = make_maze(g->xdim, g->ydim, g->playerx, g->playery,
+					g->playerdir, &g->rng);
+		if (object_store_set_maze(&g->objs, i, g->maze[i])) {
+			fprintf(stderr, "Out of memory for level %d\n", i);
+			game_free(g);
+			return -1;
+		}
+		if (c->print_mazes) {
+			print_maze(g->maze[i], g->xdim, g->ydim,
+				g->playerx, g->playery, g->playerdir);
+			printf("density = %f\n",
+				maze_density(g->maze[i], g->xdim, g->ydim));
+		}
+		if (spawn_objects(g, i, OBJ_ROBOT, c->nrobots) ||
+			spawn_objects(g, i, OBJ_FIRSTAIDKIT, c->nfirstaidkits) ||
+			spawn_objects(g, i, OBJ_LASERPISTOL, c->nlaserpistols) ||
+			spawn_objects(g, i, OBJ_GRENADE, c->ngrenades))
+			goto full;
+	}
+	for (i = 1; i < MAXLEVELS; i++)
+		if (add_ladders(g, i))
+			goto full;
+	if (ladder_graph_build(&g->ladders, g->maze)) {
+		fprintf(stderr, "Out of memory for ladders\n");
+		game_free(g);
+		return -1;
+	}
+	object_store_set_lod(&g->objs, &c->lod);
+	object_store_set_active_level(&g->objs, g->playerlevel);
+	object_store_set_target(&g->objs, g->playerlevel, g->playerx, g->playery);
+	explore(g);
+
+	sim_clock_init(&g->clock, c->sim_hz);
+	g->player_move_ticks = sim_clock_seconds_to_ticks(&g->clock,
+							PLAYER_MOVE_TIME);
+	return 0;
+
+full:
+	fprintf(stderr, "Ran out of room for objects, %d isn't enough\n",
+		c->maxobjs);
+	game_free(g);
+	return -1;
+}
+
+void game_free(struct game *g)
+{
+	int i;
+
+	object_store_free(&g->objs);
+	ladder_graph_free(&g->ladders);
+	automap_free(&g->map);
+	for (i = 0; i < MAXLEVELS; i++)
+		free(g->maze[i]);
+	memset(g, 0, sizeof(*g));
+}
+
+int game_route(struct game *g, int level, int x, int y, struct ladder_route *r)
+{
+	return ladder_graph_route(&g->ladders, g->maze, g->playerlevel,
+				g->playerx, g->playery, level, x, y, r);
+}
+
+unsigned int game_checksum(struct game *g)
+{
+	int player[4] = { g->playerx, g->playery, g->playerdir, g->playerlevel };
+	unsigned int h = 2166136261u;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(player); i++) {
+		h ^= player[i];
+		h *= 16777619u;
+	}
+	return object_store_checksum(&g->objs, h);
+}
@@ -0,0 +1,141 @@
+#ifndef GAME_H
+#define GAME_H
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+
+#include "maze.h"
+#include "objects.h"
+#include "laddergraph.h"
+#include "automap.h"
+#include "simclock.h"
+
+#define MAXLEVELS 5
+#define DEFAULT_MAXOBJS 1000
+#define LADDERS_BETWEEN_LEVELS 5
+
+struct game_config {
+	unsigned int seed;
+	int sim_hz;
+	struct sim_lod lod;
+	int nrobots, nfirstaidkits, nlaserpistols, ngrenades;	/* per level */
+	int maxobjs;		/* most objects there can be at once */
+	int print_mazes;
+};
+
+/* Things that happened this frame worth showing, which the renderer
+ * takes and clears.  Nothing in the game depends on them.
+ */
+enum game_effect_type {
+	EFFECT_LASER_HIT,
+	EFFECT_BLAST,
+};
+
+struct game_effect {
+	unsigned char type;
+	unsigned char level;
+	short x, y;
+};
+
+#define MAX_EFFECTS 16
+
+/* Everything about one game in progress.  Nothing in here is shared with
+ * any other game, so any number of them can be run at once, one per
+ * thread, with no locking.
+ */
+struct game {
+	int xdim, ydim;
+	char *maze[MAXLEVELS];
+	struct object_store objs;
+	struct ladder_graph ladders;	/* how the levels join up */
+	struct automap map;		/* what the player's seen of them */
+	struct sim_clock clock;
+	unsigned int rng;	/* for making the world, robots have their own */
+
+	int playerx, playery, playerdir, playerlevel;
+	unsigned long player_move_ticks;
+	unsigned long last_move_tick;
+
+	/* what the player (or whatever's playing) is asking for */
+	int requested_forward;
+	int requested_backward;
+	int requested_left;
+	int requested_right;
+	int requested_button_zero;	/* climb */
+	int requested_button_one;	/* fire the laser pistol */
+	int requested_button_two;	/* throw a grenade */
+
+	/* what the player's carrying */
+	int laserpistols;
+	int grenades;
+	int firstaidkits;
+
+	/* stats */
+	unsigned long player_moves;
+	unsigned long ladders_climbed;
+	int deepest_level;
+	unsigned long robots_killed;
+	unsigned long items_picked_up;
+
+	struct game_effect effect[MAX_EFFECTS];
+	int neffects;
+};
+
+extern void game_default_config(struct game_config *c);
+/* Returns 0, or -1 with a message on stderr if the world didn't fit */
+extern int game_setup(struct game *g, struct game_config *c);
+extern void game_free(struct game *g);
+
+/* Run one simulation tick on whatever's requested and count it.  Returns
+ * what came of the player's input: GAME_TICK_MOVED if they went anywhere,
+ * turned, or changed level, GAME_TICK_WAITING if they're asking to but
+ * it's too soon after their last move, else GAME_TICK_IDLE (nothing
+ * asked for, or walked into a wall, say).
+ */
+#define GAME_TICK_IDLE 0
+#define GAME_TICK_MOVED 1
+#define GAME_TICK_WAITING 2
+extern int game_tick(struct game *g);
+
+/* all the requested_* flags packed into one int, and back */
+#define REQUEST_FORWARD (1 << 0)
+#define REQUEST_BACKWARD (1 << 1)
+#define REQUEST_LEFT (1 << 2)
+#define REQUEST_RIGHT (1 << 3)
+#define REQUEST_BUTTON_ZERO (1 << 4)
+#define REQUEST_BUTTON_ONE (1 << 5)
+#define REQUEST_BUTTON_TWO (1 << 6)
+
+extern int game_requested_bits(struct game *g);
+extern void game_set_requested_bits(struct game *g, int bits);
+
+/* Is there one of these where the player's standing */
+extern int game_player_on(struct game *g, enum object_type type);
+
+/* Shortest way from the player to x, y on level, and where to head
+ * first.  Returns the number of steps, -1 if there's no way there.
+ */
+extern int game_route(struct game *g, int level, int x, int y,
+			struct ladder_route *r);
+
+/* hash of where the player and every object is */
+extern unsigned int game_checksum(struct game *g);
+
+#endif
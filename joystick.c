@@ -193,16 +193,44 @@ int get_joystick_status(struct wwvi_js_event *wjse)
 	if(FAILED(hr))
 		return -1;
 
-	/* write out state */
+	/* write out state, polled so there are no event times to trace
+	 * input latency from
+	 */
+	wjse->nevents = 0;
 	wjse->stick_x = js.lX;
 	wjse->stick_y = js.lY;
 	for (i = 0; i < 11; ++i) {
-		wjse->button[i] = (js.rgbButtons[i] & 0x80) ? 1 : 0;
+		int pressed = (js.rgbButtons[i] & 0x80) ? 1 : 0;
+		if (pressed && !wjse->button[i])
+			wjse->button_pressed[i]++;
+		wjse->button[i] = pressed;
 	}
 
 	return 0;
 }
 
+int start_joystick_thread(void)
+{
+	/* not implemented, DirectInput gets polled */
+	return -1;
+}
+
+int start_joystick_injector(__attribute__((unused)) double hz)
+{
+	/* not implemented */
+	return -1;
+}
+
+void stop_joystick_thread(void)
+{
+}
+
+int joystick_drain_events(__attribute__((unused)) struct js_timed_event *ev,
+				__attribute__((unused)) int max)
+{
+	return 0;
+}
+
 #else
 
 #include <stdio.h>
@@ -212,6 +240,10 @@ int get_joystick_status(struct wwvi_js_event *wjse)
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
 
 static int joystick_fd = -1;
 
@@ -251,35 +283,243 @@ int read_joystick_event(struct js_event *jse)
 
 void close_joystick()
 {
+	stop_joystick_thread();
 	close(joystick_fd);
 }
 
+/* Single producer (the input thread), single consumer (the game) ring of
+ * events.  head is only written by the producer, tail by the consumer.
+ */
+#define JS_RING_SIZE 1024 /* must be a power of 2 */
+static struct js_timed_event js_ring[JS_RING_SIZE];
+static unsigned int js_ring_head;
+static unsigned int js_ring_tail;
+
+static pthread_t js_thread;
+static int js_thread_running = 0;
+static int js_thread_wakeup[2] = { -1, -1 };
+
+static double js_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void js_ring_put(struct js_event *e, double t)
+{
+	unsigned int head = js_ring_head;
+
+	/* Never drop events, button presses must all get through.  If the
+	 * game isn't keeping up, wait, and let the kernel buffer them.
+	 */
+	while (head - __atomic_load_n(&js_ring_tail, __ATOMIC_ACQUIRE) >= JS_RING_SIZE)
+		usleep(1000);
+	js_ring[head & (JS_RING_SIZE - 1)].e = *e;
+	js_ring[head & (JS_RING_SIZE - 1)].t = t;
+	__atomic_store_n(&js_ring_head, head + 1, __ATOMIC_RELEASE);
+}
+
+int joystick_drain_events(struct js_timed_event *ev, int max)
+{
+	unsigned int tail = js_ring_tail;
+	unsigned int head = __atomic_load_n(&js_ring_head, __ATOMIC_ACQUIRE);
+	int n = 0;
+
+	while (tail != head && n < max)
+		ev[n++] = js_ring[tail++ & (JS_RING_SIZE - 1)];
+	__atomic_store_n(&js_ring_tail, tail, __ATOMIC_RELEASE);
+	return n;
+}
+
+static void *joystick_thread(__attribute__((unused)) void *arg)
+{
+	struct js_event buf[64];
+	struct pollfd pfd[2];
+	int i, n, bytes;
+	double t;
+
+	pfd[0].fd = joystick_fd;
+	pfd[0].events = POLLIN;
+	pfd[1].fd = js_thread_wakeup[0];
+	pfd[1].events = POLLIN;
+
+	for (;;) {
+		if (poll(pfd, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (pfd[1].revents)
+			break;
+		if (pfd[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+			break;
+		t = js_now();
+		/* the driver hands back as many whole events as fit */
+		while ((bytes = read(joystick_fd, buf, sizeof(buf))) > 0) {
+			n = bytes / sizeof(buf[0]);
+			for (i = 0; i < n; i++)
+				js_ring_put(&buf[i], t);
+		}
+		if (bytes < 0 && errno != EAGAIN && errno != EINTR)
+			break;
+	}
+	return NULL;
+}
+
+static double inject_hz;
+
+static int inject_sleep(double seconds)
+{
+	struct pollfd pfd;
+
+	pfd.fd = js_thread_wakeup[0];
+	pfd.events = POLLIN;
+	return poll(&pfd, 1, (int) (seconds * 1000.0)) != 0;
+}
+
+static void inject(unsigned char type, unsigned char number, short value)
+{
+	struct js_event e;
+	double t = js_now();
+
+	e.time = (unsigned int) (t * 1000.0);
+	e.type = type;
+	e.number = number;
+	e.value = value;
+	js_ring_put(&e, t);
+}
+
+static void *joystick_injector(__attribute__((unused)) void *arg)
+{
+	unsigned int seed = 1;
+	int axis;
+	short value;
+
+	/* a press of button 1 to get us out of attract mode */
+	inject(JS_EVENT_BUTTON, 1, 1);
+	inject(JS_EVENT_BUTTON, 1, 0);
+
+	for (;;) {
+		if (inject_sleep(1.0 / inject_hz))
+			break;
+		/* don't use random(), leave that to the game */
+		switch (rand_r(&seed) % 5) {
+		case 0:
+			inject(JS_EVENT_BUTTON, 0, 1);
+			if (inject_sleep(0.05))
+				return NULL;
+			inject(JS_EVENT_BUTTON, 0, 0);
+			continue;
+		case 1: axis = joystick_x_axis; value = -32767; break;
+		case 2: axis = joystick_x_axis; value = 32767; break;
+		case 3: axis = joystick_y_axis; value = 32767; break;
+		default: axis = joystick_y_axis; value = -32767; break;
+		}
+		inject(JS_EVENT_AXIS, axis, value);
+		if (inject_sleep(0.1))
+			break;
+		inject(JS_EVENT_AXIS, axis, 0);
+	}
+	return NULL;
+}
+
+static int start_thread(void *(*fn)(void *))
+{
+	if (js_thread_running)
+		return -1;
+	if (pipe(js_thread_wakeup) < 0)
+		return -1;
+	if (pthread_create(&js_thread, NULL, fn, NULL) != 0) {
+		close(js_thread_wakeup[0]);
+		close(js_thread_wakeup[1]);
+		return -1;
+	}
+	js_thread_running = 1;
+	return 0;
+}
+
+int start_joystick_thread(void)
+{
+	if (joystick_fd < 0)
+		return -1;
+	return start_thread(joystick_thread);
+}
+
+int start_joystick_injector(double hz)
+{
+	if (hz <= 0.0)
+		return -1;
+	inject_hz = hz;
+	return start_thread(joystick_injector);
+}
+
+void stop_joystick_thread(void)
+{
+	if (!js_thread_running)
+		return;
+	if (write(js_thread_wakeup[1], "x", 1) != 1)
+		return;
+	pthread_join(js_thread, NULL);
+	close(js_thread_wakeup[0]);
+	close(js_thread_wakeup[1]);
+	js_thread_running = 0;
+}
+
+static void apply_joystick_event(struct wwvi_js_event *wjse, struct js_event *jse)
+{
+	jse->type &= ~JS_EVENT_INIT; /* ignore synthetic events */
+	if (jse->type == JS_EVENT_AXIS) {
+		if (jse->number == joystick_x_axis)
+			wjse->stick_x = jse->value;
+		if (jse->number == joystick_y_axis)
+			wjse->stick_y = jse->value;
+	} else if (jse->type == JS_EVENT_BUTTON) {
+		if (jse->number < 11) {
+			switch (jse->value) {
+			case 1: if (!wjse->button[jse->number])
+					wjse->button_pressed[jse->number]++;
+				/* fall through */
+			case 0: wjse->button[jse->number] = jse->value;
+				break;
+			default:
+				break;
+			}
+		}
+	}
+}
+
 int get_joystick_status(struct wwvi_js_event *wjse)
 {
-	int rc;
+	struct js_timed_event ev[64];
 	struct js_event jse;
+	int i, n;
+
+	wjse->nevents = 0;
+	if (js_thread_running) {
+		while ((n = joystick_drain_events(ev, 64)) > 0) {
+			if (wjse->nevents == 0) {
+				wjse->first_event_time = ev[0].e.time;
+				wjse->first_event_arrival = ev[0].t;
+			}
+			wjse->nevents += n;
+			for (i = 0; i < n; i++)
+				apply_joystick_event(wjse, &ev[i].e);
+		}
+		return 0;
+	}
+
 	if (joystick_fd < 0)
 		return -1;
 
 	/* memset(wjse, 0, sizeof(*wjse)); */
-	while ((rc = read_joystick_event(&jse) == 1)) {
-		jse.type &= ~JS_EVENT_INIT; /* ignore synthetic events */
-		if (jse.type == JS_EVENT_AXIS) {
-			if (jse.number == joystick_x_axis)
-				wjse->stick_x = jse.value;
-			if (jse.number == joystick_y_axis)
-				wjse->stick_y = jse.value;
-		} else if (jse.type == JS_EVENT_BUTTON) {
-			if (jse.number < 11) {
-				switch (jse.value) {
-				case 0:
-				case 1: wjse->button[jse.number] = jse.value;
-					break;
-				default:
-					break;
-				}
-			}
+	while (read_joystick_event(&jse) == 1) {
+		if (wjse->nevents++ == 0) {
+			wjse->first_event_time = jse.time;
+			wjse->first_event_arrival = js_now();
 		}
+		apply_joystick_event(wjse, &jse);
 	}
 	/* printf("%d\n", wjse->stick1_y); */
 	return 0;
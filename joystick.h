@@ -42,8 +42,19 @@ struct js_event {
 
 struct wwvi_js_event {
 	int button[11];
+	int button_pressed[11];	/* presses since last cleared by the caller */
 	int stick_x;
 	int stick_y;
+	/* what get_joystick_status() just read, for latency tracing */
+	int nevents;
+	unsigned int first_event_time;	/* js_event timestamp, ms */
+	double first_event_arrival;	/* CLOCK_MONOTONIC seconds */
+};
+
+/* An event as queued by the input thread, with the time it was read */
+struct js_timed_event {
+	struct js_event e;
+	double t;	/* CLOCK_MONOTONIC seconds */
 };
 
 #ifdef __WIN32__
@@ -57,4 +68,18 @@ extern void set_joystick_x_axis(int axis);
 extern void close_joystick();
 extern int get_joystick_status(struct wwvi_js_event *wjse);
 
+/* Instead of polling the device once per frame, a thread can sit in
+ * poll() on it and queue events as they arrive.  get_joystick_status()
+ * then just drains the queue.  Returns 0 if the thread started.
+ */
+extern int start_joystick_thread(void);
+extern void stop_joystick_thread(void);
+extern int joystick_drain_events(struct js_timed_event *ev, int max);
+
+/* For running without a joystick: a thread feeds the same queue the
+ * input thread would with made up stick pushes and button presses,
+ * about hz of them a second.
+ */
+extern int start_joystick_injector(double hz);
+
 #endif
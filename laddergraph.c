@@ -0,0 +1,527 @@
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "maze.h"
+#include "flowfield.h"
+#include "laddergraph.h"
+
+int ladder_graph_setup(struct ladder_graph *g, int nlevels, int xdim, int ydim)
+{
+	memset(g, 0, sizeof(*g));
+	g->nlevels = nlevels;
+	g->xdim = xdim;
+	g->ydim = ydim;
+	g->first = calloc(nlevels + 1, sizeof(*g->first));
+	g->base = calloc(nlevels + 1, sizeof(*g->base));
+	if (!g->first || !g->base ||
+		flow_field_setup(&g->from, xdim, ydim, FLOW_FIELD_FAR)) {
+		ladder_graph_free(g);
+		return -1;
+	}
+	return 0;
+}
+
+void ladder_graph_free(struct ladder_graph *g)
+{
+	free(g->node);
+	free(g->first);
+	free(g->base);
+	free(g->dist);
+	free(g->cells);
+	free(g->cost);
+	free(g->via);
+	if (g->from.dist)
+		flow_field_free(&g->from);
+	memset(g, 0, sizeof(*g));
+}
+
+static int add_node(struct ladder_graph *g, int level, int x, int y, int other)
+{
+	struct ladder_node *n;
+	int size;
+
+	if (g->nnodes == g->maxnodes) {
+		size = g->maxnodes ? g->maxnodes * 2 : 64;
+		n = realloc(g->node, sizeof(*n) * size);
+		if (!n)
+			return -1;
+		g->node = n;
+		g->maxnodes = size;
+	}
+	n = &g->node[g->nnodes++];
+	n->level = level;
+	n->x = x;
+	n->y = y;
+	n->other = other;
+	return 0;
+}
+
+int ladder_graph_add_ladder(struct ladder_graph *g, int lowerlevel, int x, int y)
+{
+	int n = g->nnodes;
+
+	if (add_node(g, lowerlevel, x, y, n + 1) ||
+		add_node(g, lowerlevel - 1, x, y, n))
+		return -1;
+	return 0;
+}
+
+/* Put the nodes in level order, so each level's are together */
+static int sort_nodes(struct ladder_graph *g)
+{
+	struct ladder_node *sorted;
+	int *where, *next, i, l;
+
+	sorted = malloc(sizeof(*sorted) * (g->nnodes + 1));
+	where = malloc(sizeof(*where) * (g->nnodes + 1));
+	next = calloc(g->nlevels + 1, sizeof(*next));
+	if (!sorted || !where || !next) {
+		free(sorted);
+		free(where);
+		free(next);
+		return -1;
+	}
+	for (i = 0; i < g->nnodes; i++)
+		next[g->node[i].level + 1]++;
+	for (l = 0; l < g->nlevels; l++)
+		next[l + 1] += next[l];
+	memcpy(g->first, next, sizeof(*next) * (g->nlevels + 1));
+	for (i = 0; i < g->nnodes; i++)
+		where[i] = next[g->node[i].level]++;
+	for (i = 0; i < g->nnodes; i++) {
+		sorted[where[i]] = g->node[i];
+		sorted[where[i]].other = where[g->node[i].other];
+	}
+	free(g->node);
+	g->node = sorted;
+	g->maxnodes = g->nnodes + 1;
+	free(where);
+	free(next);
+	return 0;
+}
+
+/* Steps from x, y to node n, on n's level alone */
+static inline int walk(struct ladder_graph *g, int n, int x, int y)
+{
+	int d = g->cells[n * g->xdim * g->ydim + y * g->xdim + x];
+
+	return d == FLOW_FIELD_FAR ? LADDER_FAR : d;
+}
+
+static void fill_cells(struct ladder_graph *g, char *maze, int level)
+{
+	int ncells = g->xdim * g->ydim;
+	int n;
+
+	for (n = g->first[level]; n < g->first[level + 1]; n++) {
+		flow_field_clear(&g->from);
+		flow_field_update(&g->from, maze, g->node[n].x, g->node[n].y);
+		memcpy(&g->cells[n * ncells], g->from.dist,
+			sizeof(*g->cells) * ncells);
+	}
+}
+
+/* Steps between level's nodes walking that level alone, into d */
+static void walk_level(struct ladder_graph *g, int level, int *d)
+{
+	int first = g->first[level];
+	int k = g->first[level + 1] - first;
+	int i, j;
+
+	for (i = 0; i < k; i++)
+		for (j = 0; j < k; j++)
+			d[i * k + j] = walk(g, first + j, g->node[first + i].x,
+						g->node[first + i].y);
+}
+
+/* Improve d, between level's nodes, with the ways that climb to next,
+ * go from ladder to ladder there as in dnext, and climb back.
+ */
+static void detour(struct ladder_graph *g, int level, int *d,
+			int next, int *dnext)
+{
+	int first = g->first[level], nfirst = g->first[next];
+	int k = g->first[level + 1] - first;
+	int nk = g->first[next + 1] - nfirst;
+	int i, j, oi, oj, via;
+
+	for (i = 0; i < k; i++) {
+		oi = g->node[first + i].other;
+		if (g->node[oi].level != next)
+			continue;
+		for (j = 0; j < k; j++) {
+			oj = g->node[first + j].other;
+			if (g->node[oj].level != next)
+				continue;
+			via = dnext[(oi - nfirst) * nk + oj - nfirst];
+			if (via < LADDER_FAR && via + 2 < d[i * k + j])
+				d[i * k + j] = via + 2;
+		}
+	}
+}
+
+/* Floyd-Warshall, so d has the shortest ways by any of the nodes */
+static void closure(int *d, int k)
+{
+	int i, j, m;
+
+	for (m = 0; m < k; m++)
+		for (i = 0; i < k; i++) {
+			if (d[i * k + m] >= LADDER_FAR)
+				continue;
+			for (j = 0; j < k; j++)
+				if (d[i * k + m] + d[m * k + j] < d[i * k + j])
+					d[i * k + j] = d[i * k + m] + d[m * k + j];
+		}
+}
+
+/* The shortest way between two nodes on a level either stays on it, or
+ * goes up and comes back, or down and comes back, any number of times.
+ * Going up it can go up again but only come back through the same
+ * ladders, so the best ways round above each level come from the level
+ * above's, top to bottom, the best below from the bottom up, and then
+ * every level's from those of the levels either side.
+ */
+static int connect_levels(struct ladder_graph *g)
+{
+	int *up, *down, *d, l, k, n = g->base[g->nlevels];
+
+	up = malloc(sizeof(*up) * (n + 1));
+	down = malloc(sizeof(*down) * (n + 1));
+	if (!up || !down) {
+		free(up);
+		free(down);
+		return -1;
+	}
+	for (l = 0; l < g->nlevels; l++) {
+		d = &up[g->base[l]];
+		walk_level(g, l, d);
+		if (l > 0)
+			detour(g, l, d, l - 1, &up[g->base[l - 1]]);
+		closure(d, g->first[l + 1] - g->first[l]);
+	}
+	for (l = g->nlevels - 1; l >= 0; l--) {
+		d = &down[g->base[l]];
+		walk_level(g, l, d);
+		if (l < g->nlevels - 1)
+			detour(g, l, d, l + 1, &down[g->base[l + 1]]);
+		closure(d, g->first[l + 1] - g->first[l]);
+	}
+	for (l = 0; l < g->nlevels; l++) {
+		k = g->first[l + 1] - g->first[l];
+		d = &g->dist[g->base[l]];
+		walk_level(g, l, d);
+		if (l > 0)
+			detour(g, l, d, l - 1, &up[g->base[l - 1]]);
+		if (l < g->nlevels - 1)
+			detour(g, l, d, l + 1, &down[g->base[l + 1]]);
+		closure(d, k);
+	}
+	free(up);
+	free(down);
+	return 0;
+}
+
+int ladder_graph_build(struct ladder_graph *g, char **maze)
+{
+	int l, k;
+
+	if (sort_nodes(g))
+		return -1;
+	g->base[0] = 0;
+	for (l = 0; l < g->nlevels; l++) {
+		k = g->first[l + 1] - g->first[l];
+		g->base[l + 1] = g->base[l] + k * k;
+	}
+	free(g->dist);
+	free(g->cells);
+	free(g->cost);
+	free(g->via);
+	g->dist = malloc(sizeof(*g->dist) * (g->base[g->nlevels] + 1));
+	g->cells = malloc(sizeof(*g->cells) * g->xdim * g->ydim *
+				(g->nnodes + 1));
+	g->cost = malloc(sizeof(*g->cost) * (g->nnodes + 1));
+	g->via = malloc(sizeof(*g->via) * (g->nnodes + 1));
+	if (!g->dist || !g->cells || !g->cost || !g->via)
+		return -1;
+	for (l = 0; l < g->nlevels; l++)
+		fill_cells(g, maze[l], l);
+	return connect_levels(g);
+}
+
+int ladder_graph_update_level(struct ladder_graph *g, char **maze, int level)
+{
+	fill_cells(g, maze[level], level);
+	return connect_levels(g);
+}
+
+int ladder_graph_route(struct ladder_graph *g, char **maze,
+			int fromlevel, int fx, int fy,
+			int tolevel, int tx, int ty, struct ladder_route *r)
+{
+	struct ladder_node *node = g->node;
+	int *cost = g->cost, *via = g->via, *d;
+	int step = tolevel > fromlevel ? 1 : -1;
+	int l, first, k, i, n, u, e, best, last = -1;
+
+	r->steps = -1;
+	r->x = tx;
+	r->y = ty;
+	if (!inbounds(fx, fy, g->xdim, g->ydim) ||
+		!inbounds(tx, ty, g->xdim, g->ydim))
+		return -1;
+
+	best = LADDER_FAR;
+	if (fromlevel == tolevel) {
+		flow_field_clear(&g->from);
+		flow_field_update(&g->from, maze[fromlevel], fx, fy);
+		if (flow_field_distance(&g->from, tx, ty) != FLOW_FIELD_FAR)
+			best = flow_field_distance(&g->from, tx, ty);
+	}
+
+	/* to each node on the start level, by the one walked to first */
+	first = g->first[fromlevel];
+	k = g->first[fromlevel + 1] - first;
+	d = &g->dist[g->base[fromlevel]];
+	for (n = 0; n < k; n++)
+		cost[first + n] = LADDER_FAR;
+	for (i = 0; i < k; i++) {
+		e = walk(g, first + i, fx, fy);
+		if (e >= LADDER_FAR)
+			continue;
+		for (n = 0; n < k; n++) {
+			if (e + d[i * k + n] < cost[first + n]) {
+				cost[first + n] = e + d[i * k + n];
+				via[first + n] = first + i;
+			}
+		}
+	}
+
+	/* then each level on the way, by the ladder come down or up */
+	for (l = fromlevel; l != tolevel; l += step) {
+		first = g->first[l + step];
+		k = g->first[l + step + 1] - first;
+		d = &g->dist[g->base[l + step]];
+		for (n = 0; n < k; n++)
+			cost[first + n] = LADDER_FAR;
+		for (u = 0; u < k; u++) {
+			if (node[node[first + u].other].level != l)
+				continue;
+			e = cost[node[first + u].other] + 1;
+			if (e >= LADDER_FAR)
+				continue;
+			for (n = 0; n < k; n++) {
+				if (e + d[u * k + n] < cost[first + n]) {
+					cost[first + n] = e + d[u * k + n];
+					via[first + n] = first + u;
+				}
+			}
+		}
+	}
+
+	/* and from the target level's nodes, walk to the target */
+	for (n = g->first[tolevel]; n < g->first[tolevel + 1]; n++) {
+		e = walk(g, n, tx, ty);
+		if (e < LADDER_FAR && cost[n] + e < best) {
+			best = cost[n] + e;
+			last = n;
+		}
+	}
+	if (best >= LADDER_FAR)
+		return -1;
+
+	/* back up the ladders to which to head for first */
+	r->steps = best;
+	if (last >= 0) {
+		for (n = last; node[n].level != fromlevel; )
+			n = node[via[n]].other;
+		r->x = node[via[n]].x;
+		r->y = node[via[n]].y;
+	}
+	return r->steps;
+}
+
+#ifdef LADDERGRAPH_BENCHMARK
+/* Route queries between random corridor cells on random levels of
+ * dungeons of more and more levels joined as the game joins them:
+ * "graph" by the ladder graph, "flat" by a breadth first search of every
+ * level's cells and ladders at once, which is what anything wanting a
+ * route would otherwise do.  Checks the two agree, too.
+ */
+#include <time.h>
+
+#include "my_point.h"
+
+#define LADDERS 5		/* between each two levels, as in the game */
+#define ROUTES 20000
+#define FLAT_ROUTES 200
+
+static unsigned int bench_rng = 1234;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#define CELLS (XDIM * YDIM)
+#define UP 1		/* ladder to the level above, level - 1 */
+#define DOWN 2
+
+static int flat_route(char **maze, unsigned char *ladder, int *dist,
+			int *queue, int nlevels, int from, int to)
+{
+	int head = 0, tail = 0, c, n, l, x, y, dir;
+
+	memset(dist, 0xff, sizeof(*dist) * nlevels * CELLS);
+	dist[from] = 0;
+	queue[tail++] = from;
+	while (head < tail) {
+		c = queue[head++];
+		if (c == to)
+			return dist[c];
+		l = c / CELLS;
+		x = (c % CELLS) % XDIM;
+		y = (c % CELLS) / XDIM;
+		for (dir = 0; dir < 6; dir++) {
+			if (dir < 4) {
+				if (!inbounds(x + xo[dir], y + yo[dir], XDIM, YDIM))
+					continue;
+				n = c + yo[dir] * XDIM + xo[dir];
+				if (maze[l][n % CELLS] != '#')
+					continue;
+			} else if (dir == 4 && (ladder[c] & UP)) {
+				n = c - CELLS;
+			} else if (dir == 5 && (ladder[c] & DOWN)) {
+				n = c + CELLS;
+			} else {
+				continue;
+			}
+			if (dist[n] >= 0)
+				continue;
+			dist[n] = dist[c] + 1;
+			queue[tail++] = n;
+		}
+	}
+	return -1;
+}
+
+static void random_cell(char **maze, int nlevels, int *l, int *x, int *y)
+{
+	*l = randomn(&bench_rng, nlevels);
+	do {
+		*x = randomn(&bench_rng, XDIM);
+		*y = randomn(&bench_rng, YDIM);
+	} while (maze[*l][*y * XDIM + *x] != '#');
+}
+
+static void bench_levels(int nlevels)
+{
+	struct ladder_graph g;
+	struct ladder_route r;
+	char **maze;
+	unsigned char *ladder;
+	int *dist, *queue;
+	int i, l, x, y, c, fl, fx, fy, tl, tx, ty, steps, wrong = 0;
+	unsigned int rng;
+	double t0, tbuild, tgraph, tflat;
+
+	maze = malloc(sizeof(*maze) * nlevels);
+	ladder = calloc(nlevels * CELLS, 1);
+	dist = malloc(sizeof(*dist) * nlevels * CELLS);
+	queue = malloc(sizeof(*queue) * nlevels * CELLS);
+	for (l = 0; l < nlevels; l++)
+		maze[l] = make_maze(XDIM, YDIM, XDIM / 2, YDIM - 2, 0, &bench_rng);
+
+	t0 = now();
+	ladder_graph_setup(&g, nlevels, XDIM, YDIM);
+	for (l = 1; l < nlevels; l++) {
+		for (i = 0; i < LADDERS; i++) {
+			do {
+				x = randomn(&bench_rng, XDIM);
+				y = randomn(&bench_rng, YDIM);
+				c = y * XDIM + x;
+			} while (maze[l][c] != '#' || maze[l - 1][c] != '#');
+			if (ladder[l * CELLS + c] || ladder[(l - 1) * CELLS + c])
+				continue;
+			ladder[l * CELLS + c] |= UP;
+			ladder[(l - 1) * CELLS + c] |= DOWN;
+			ladder_graph_add_ladder(&g, l, x, y);
+		}
+	}
+	ladder_graph_build(&g, maze);
+	tbuild = now() - t0;
+
+	rng = bench_rng;
+	t0 = now();
+	for (i = 0; i < ROUTES; i++) {
+		random_cell(maze, nlevels, &fl, &fx, &fy);
+		random_cell(maze, nlevels, &tl, &tx, &ty);
+		ladder_graph_route(&g, maze, fl, fx, fy, tl, tx, ty, &r);
+	}
+	tgraph = now() - t0;
+
+	/* the same routes again, the slow way, checking the answers */
+	bench_rng = rng;
+	tflat = 0.0;
+	for (i = 0; i < FLAT_ROUTES; i++) {
+		random_cell(maze, nlevels, &fl, &fx, &fy);
+		random_cell(maze, nlevels, &tl, &tx, &ty);
+		t0 = now();
+		steps = flat_route(maze, ladder, dist, queue, nlevels,
+				fl * CELLS + fy * XDIM + fx,
+				tl * CELLS + ty * XDIM + tx);
+		tflat += now() - t0;
+		if (ladder_graph_route(&g, maze, fl, fx, fy, tl, tx, ty,
+					&r) != steps)
+			wrong++;
+	}
+
+	printf("%7d %7d %10.2f %10.2f %10.2f %7d\n", nlevels, g.nnodes,
+		tbuild * 1e3, tgraph * 1e6 / ROUTES, tflat * 1e6 / FLAT_ROUTES,
+		wrong);
+
+	ladder_graph_free(&g);
+	for (l = 0; l < nlevels; l++)
+		free(maze[l]);
+	free(maze);
+	free(ladder);
+	free(dist);
+	free(queue);
+}
+
+int main(__attribute__((unused)) int argc, __attribute__((unused)) char *argv[])
+{
+	int levels[] = { 5, 20, 100, 300, 1000 };
+	unsigned int i;
+
+	printf("%7s %7s %10s %10s %10s %7s\n", "levels", "nodes", "build ms",
+		"graph us", "flat us", "wrong");
+	for (i = 0; i < ARRAY_SIZE(levels); i++)
+		bench_levels(levels[i]);
+	return 0;
+}
+#endif
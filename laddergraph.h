@@ -0,0 +1,87 @@
+#ifndef LADDERGRAPH_H
+#define LADDERGRAPH_H
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+
+#include "flowfield.h"
+
+/* Levels only join up through ladders, so getting from one level to
+ * another is a matter of which ladders to take.  The ladder graph has a
+ * node for each end of each ladder, and for each level, how far apart
+ * its nodes are, counting ways round through other levels, and how far
+ * every cell is from each.  Since any way from one level to another has
+ * to take one of the ladders between each two levels on the way, a route
+ * query is then a few sums per ladder per level in between, never a
+ * search of any level's cells, for the price of a table of a level's
+ * cells per ladder end.
+ */
+#define LADDER_FAR 0x3fffffff
+
+struct ladder_node {
+	int level;
+	short x, y;
+	int other;		/* the node at the other end of the ladder */
+};
+
+struct ladder_route {
+	int steps;		/* moves and climbs to get there, -1 if no way */
+	int x, y;		/* where to head first: a ladder, or the target */
+};
+
+struct ladder_graph {
+	int nlevels, xdim, ydim;
+	int nnodes, maxnodes;
+	struct ladder_node *node;	/* by level once built */
+	int *first;		/* level l's nodes are first[l] to first[l + 1] - 1 */
+	int *base;		/* where level l's distances start in dist[] */
+	int *dist;		/* k * k steps between each level's k nodes */
+	unsigned short *cells;	/* xdim * ydim steps from each cell to node n */
+
+	/* for route queries */
+	struct flow_field from;
+	int *cost, *via;	/* steps to each node, and from which */
+};
+
+extern int ladder_graph_setup(struct ladder_graph *g, int nlevels,
+				int xdim, int ydim);
+extern void ladder_graph_free(struct ladder_graph *g);
+
+/* A ladder at x, y going between lowerlevel and the one above */
+extern int ladder_graph_add_ladder(struct ladder_graph *g, int lowerlevel,
+				int x, int y);
+
+/* Once all the ladders are in, work out every level's distances */
+extern int ladder_graph_build(struct ladder_graph *g, char **maze);
+
+/* Redo the distances after one level's maze has changed */
+extern int ladder_graph_update_level(struct ladder_graph *g, char **maze,
+				int level);
+
+/* Shortest way from fx, fy on fromlevel to tx, ty on tolevel, counting
+ * each climb as a step.  Returns r->steps.  Only a route within one level
+ * searches that level's cells, for the way that doesn't use ladders.
+ */
+extern int ladder_graph_route(struct ladder_graph *g, char **maze,
+				int fromlevel, int fx, int fy,
+				int tolevel, int tx, int ty,
+				struct ladder_route *r);
+
+#endif
@@ -0,0 +1,161 @@
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "latency.h"
+
+enum latency_stage {
+	STAGE_READ,	/* joystick event to our reading it */
+	STAGE_SIM,	/* reading it to the simulation acting on it */
+	STAGE_RENDER,	/* acting on it to the frame going out */
+	STAGE_TOTAL,
+	NSTAGES,
+};
+
+static const char *stage_name[NSTAGES] = {
+	"read", "sim", "render", "total",
+};
+
+#define MAXSAMPLES 8192
+
+static struct latency_samples {
+	int n;		/* samples taken, the last MAXSAMPLES are kept */
+	float s[MAXSAMPLES];
+} samples[NSTAGES];
+
+static int enabled = 0;
+
+static enum {
+	TRACE_IDLE,
+	TRACE_INPUT,
+	TRACE_APPLIED,
+} trace_state = TRACE_IDLE;
+
+static double trace_input, trace_arrival, trace_applied;
+
+void latency_enable(void)
+{
+	enabled = 1;
+}
+
+double latency_kernel_time(unsigned int ms, double arrival)
+{
+	static double offset;
+	static int have_offset = 0;
+	double o = arrival - ms / 1000.0;
+
+	/* The kernel's clock isn't ours.  The smallest difference seen
+	 * between them is the one with the least delay in it, use that.
+	 */
+	if (!have_offset || o < offset) {
+		offset = o;
+		have_offset = 1;
+	}
+	return ms / 1000.0 + offset;
+}
+
+void latency_input(double input_time, double arrival_time)
+{
+	if (!enabled || trace_state != TRACE_IDLE)
+		return;
+	trace_input = input_time;
+	trace_arrival = arrival_time;
+	trace_state = TRACE_INPUT;
+}
+
+void latency_applied(double t)
+{
+	if (trace_state != TRACE_INPUT)
+		return;
+	trace_applied = t;
+	trace_state = TRACE_APPLIED;
+}
+
+void latency_cancel(void)
+{
+	if (trace_state == TRACE_INPUT)
+		trace_state = TRACE_IDLE;
+}
+
+static void add_sample(enum latency_stage stage, double seconds)
+{
+	struct latency_samples *l = &samples[stage];
+
+	l->s[l->n % MAXSAMPLES] = seconds;
+	l->n++;
+}
+
+void latency_frame(double t)
+{
+	if (trace_state != TRACE_APPLIED)
+		return;
+	add_sample(STAGE_READ, trace_arrival - trace_input);
+	add_sample(STAGE_SIM, trace_applied - trace_arrival);
+	add_sample(STAGE_RENDER, t - trace_applied);
+	add_sample(STAGE_TOTAL, t - trace_input);
+	trace_state = TRACE_IDLE;
+}
+
+static int compare_float(const void *a, const void *b)
+{
+	float fa = *(const float *) a;
+	float fb = *(const float *) b;
+
+	return (fa > fb) - (fa < fb);
+}
+
+static float percentile(float *sorted, int n, float pct)
+{
+	int i = (int) (pct / 100.0 * (n - 1) + 0.5);
+
+	return sorted[i];
+}
+
+void latency_report(FILE *f)
+{
+	float sorted[MAXSAMPLES];
+	double total;
+	int i, j, n;
+
+	if (!enabled)
+		return;
+	fprintf(f, "input to photon latency, milliseconds, %d inputs traced\n",
+		samples[STAGE_TOTAL].n);
+	fprintf(f, "%8s %8s %8s %8s %8s %8s\n",
+		"stage", "p50", "p90", "p99", "max", "mean");
+	for (i = 0; i < NSTAGES; i++) {
+		n = samples[i].n < MAXSAMPLES ? samples[i].n : MAXSAMPLES;
+		if (n == 0)
+			continue;
+		memcpy(sorted, samples[i].s, sizeof(sorted[0]) * n);
+		qsort(sorted, n, sizeof(sorted[0]), compare_float);
+		total = 0.0;
+		for (j = 0; j < n; j++)
+			total += sorted[j];
+		fprintf(f, "%8s %8.2f %8.2f %8.2f %8.2f %8.2f\n", stage_name[i],
+			percentile(sorted, n, 50) * 1000.0,
+			percentile(sorted, n, 90) * 1000.0,
+			percentile(sorted, n, 99) * 1000.0,
+			sorted[n - 1] * 1000.0, total / n * 1000.0);
+	}
+}
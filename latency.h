@@ -0,0 +1,49 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+#include <stdio.h>
+
+/* Input to photon latency tracing.  One input at a time is followed
+ * through the game: when the joystick event happened, when we read it,
+ * when the simulation changed the player's pose because of it, and when
+ * the first frame showing that pose went out to the laser.  Inputs which
+ * arrive while one is being followed aren't traced.  All times are
+ * CLOCK_MONOTONIC seconds.
+ */
+
+extern void latency_enable(void);
+
+/* Convert a js_event millisecond timestamp to CLOCK_MONOTONIC seconds,
+ * given when we read the event.
+ */
+extern double latency_kernel_time(unsigned int ms, double arrival);
+
+extern void latency_input(double input_time, double arrival_time);
+extern void latency_applied(double t);
+/* the traced input turned out to do nothing (walked into a wall, say, or
+ * was let go of while the player couldn't move yet)
+ */
+extern void latency_cancel(void);
+extern void latency_frame(double t);
+extern void latency_report(FILE *f);
+
+#endif
@@ -0,0 +1,155 @@
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "maze.h"
+
+int xo[] = { 0, 1, 0, -1 };
+int yo[] = { -1, 0, 1, 0 };
+
+float maze_density(char *maze, int xdim, int ydim)
+{
+	int i, j;
+	float total = 0.0;
+
+	for (i = 0; i < ydim; i++)
+		for (j = 0; j < xdim; j++)
+			if (maze[i * xdim + j] == '#')
+				total = total + 1.0;
+	return total / (float) (xdim * ydim);
+}
+
+void print_maze(char *maze, int xdim, int ydim,
+		int playerx, int playery, int playerdir)
+{
+	int i, j;
+
+	for (i = 0; i < ydim; i++) {
+		for (j = 0; j < xdim; j++) {
+			if (i == playery && j == playerx) {
+				switch (playerdir) {
+				case 0: printf("^");
+					break;
+				case 1: printf(">");
+					break;
+				case 2: printf("v");
+					break;
+				case 3: printf("<");
+					break;
+				default:
+					printf("?");
+					break;
+				}
+			} else {
+				printf("%c", maze[i * xdim + j]);
+			}
+		}
+		printf("\n");
+	}
+}
+
+int inbounds_for_digging(int x, int y, int xdim, int ydim)
+{
+	if (x < 1 || x >= xdim -1 || y < 1 || y >= ydim -1)
+		return 0;
+	return 1;
+}
+
+int inbounds(int x, int y, int xdim, int ydim)
+{
+	if (x < 0 || x >= xdim || y < 0 || y >= ydim)
+		return 0;
+	return 1;
+}
+
+static int ok_to_dig(char *maze, int x, int y, int direction,
+			int xdim, int ydim)
+{
+	int left, right;
+
+	x += xo[direction];
+	y += yo[direction];
+
+	if (!inbounds_for_digging(x, y, xdim, ydim))
+		return 0;
+	if (maze[y * xdim + x] != '.')
+		return 0;
+	left = direction - 1;
+	if (left < 0)
+		left = 3;
+	if (maze[(y + yo[left]) * xdim + x + xo[left]] != '.')
+		return 0;
+	right = direction + 1;
+	if (right > 3)
+		right = 0;
+	if (maze[(y + yo[right]) * xdim + x + xo[right]] != '.')
+		return 0;
+	return 1;
+}
+
+static void dig(char *maze, int x, int y, int direction, int xdim, int ydim,
+		unsigned int *rng)
+{
+	int left, right;
+
+	maze[y * xdim + x] = '#';
+
+	if (randomn(rng, 100) < 7)
+		return;
+
+	if (ok_to_dig(maze, x, y, direction, xdim, ydim))
+		dig(maze, x + xo[direction], y + yo[direction],
+			direction, xdim, ydim, rng);
+	if (randomn(rng, 100) < 20) {
+		left = direction - 1;
+		if (left < 0)
+			left = 3;
+		if (ok_to_dig(maze, x, y, left, xdim, ydim))
+			dig(maze, x + xo[left], y + yo[left], left, xdim, ydim, rng);
+	}
+	if (randomn(rng, 100) < 20) {
+		right = direction + 1;
+		if (right > 3)
+			right = 0;
+		if (ok_to_dig(maze, x, y, right, xdim, ydim))
+			dig(maze, x + xo[right], y + yo[right], right, xdim, ydim, rng);
+	}
+}
+
+char *make_maze(int xdim, int ydim, int startx, int starty, int startdir,
+		unsigned int *rng)
+{
+	char *maze;
+	float density;
+
+	for (;;) {
+		maze = malloc(mazesize(xdim, ydim));
+		memset(maze, '.', mazesize(xdim, ydim));
+		dig(maze, startx, starty, startdir, xdim, ydim, rng);
+		density = maze_density(maze, xdim, ydim);
+		if (density > 0.30)
+			break;
+		free(maze);
+	}
+	return maze;
+}
@@ -0,0 +1,54 @@
+#ifndef MAZE_H
+#define MAZE_H
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+
+#include <stdlib.h>
+
+/* Maze dimensions, in units of chars */
+#define XDIM 70
+#define YDIM 20
+
+/* direction offsets, 0 = north, 1 = east, 2 = south, 3 = west */
+extern int xo[];
+extern int yo[];
+
+/* get a random number between 0 and n-1... fast and loose algorithm.
+ * The state is the caller's, so that games running side by side in
+ * different threads don't share (or fight over) one sequence.
+ */
+static inline int randomn(unsigned int *rng, int n)
+{
+	return rand_r(rng) % n;
+}
+
+#define mazesize(xdim, ydim) \
+	(sizeof(char) * xdim * ydim)
+
+extern int inbounds_for_digging(int x, int y, int xdim, int ydim);
+extern int inbounds(int x, int y, int xdim, int ydim);
+extern float maze_density(char *maze, int xdim, int ydim);
+extern void print_maze(char *maze, int xdim, int ydim,
+			int playerx, int playery, int playerdir);
+extern char *make_maze(int xdim, int ydim, int startx, int starty, int startdir,
+			unsigned int *rng);
+
+#endif
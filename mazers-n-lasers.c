@@ -23,11 +23,24 @@
 #include <string.h>
 #include <sys/time.h>
 #include <math.h>
+#include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
 
 #include "libol.h"
 #include "joystick.h"
 #include "my_point.h"
-#include "snis_alloc.h"
+#include "maze.h"
+#include "objects.h"
+#include "simclock.h"
+#include "game.h"
+#include "batch.h"
+#include "latency.h"
+#include "replay.h"
+#include "particles.h"
+#include "font.h"
+#include "track.h"
+#include "vpack.h"
 
 #define SCREEN_WIDTH (1000.0)
 #define SCREEN_HEIGHT (1000.0)
@@ -51,49 +64,54 @@ static int levelcolor[] = {
 	GREEN,
 };
 
-/* Maze dimensions, in units of chars */
-#define XDIM 70
-#define YDIM 20
+static struct game game;
+static struct game_config config;
 
-static int xo[] = { 0, 1, 0, -1 };
-static int yo[] = { -1, 0, 1, 0 };
-
-static int playerx, playery, playerdir, playerlevel;
-
-static int requested_forward = 0;
-static int requested_backward = 0;
-static int requested_left = 0;
-static int requested_right = 0;
-static int requested_button_zero = 0;
 static int attract_mode_active = 1;
 #define JOYSTICK_DEVICE "/dev/input/js0"
 static int joystick_fd = -1;
+static int joystick_active = 0;
+static double inject_input_hz = 0.0;
+static int laser_enabled = 1;
+static int latency_tracing = 0;
+static unsigned long max_frames = 0;
+static double stats_interval = 0.0;
+static volatile sig_atomic_t time_to_quit = 0;
+static int seed_given = 0;
+static char *record_file = NULL;
+static char *replay_file = NULL;
+static int replaying = 0;
+static int batch_sessions = 0;
+static int batch_threads = 0;
+static unsigned long batch_ticks = 0;
+
+/* Roughly how many points the laser gets through in a frame before the
+ * picture starts to flicker.  Everything drawn counts against it, and
+ * what's optional, like particles, only gets what's left.
+ */
+#define DEFAULT_POINT_BUDGET 1000
+static int point_budget = DEFAULT_POINT_BUDGET;
+static int frame_points = 0;	/* drawn so far this frame */
+
+/* The overhead map shows no more than this many points of wall, nearest
+ * the player first.
+ */
+#define DEFAULT_MAP_POINTS 400
+static int map_points = DEFAULT_MAP_POINTS;
+static int automap_active = 0;
+
+#define PARTICLE_POINTS 2	/* each is a blanked move then one lit line */
+#define PARTICLE_STREAK 0.03	/* seconds of travel each one's line shows */
+static struct particles particles;
+
+#define HUD_SCALE 8.0		/* screen units per font grid step */
+static struct font_cache hud_font;
+
+static char *assets_file = NULL;
+static struct vpack assets;
 
-struct object;
-
-typedef void (*move_function)(struct object *o, char *maze, float time);
-typedef void (*draw_function)(struct object *o, int sx, int sy, float scale);
-
-#define LADDERS_BETWEEN_LEVELS 5 
-#define MAXLEVELS 5
-#define MAXOBJS 1000
-static int nrobots = 20;
-static int nfirstaidkits = 20;
-static int nlaserpistols = 3;
-static int ngrenades = 3;
-static struct object {
-	int x, y, level, alive, n;
-	struct my_vect_obj *v;
-        move_function move;
-        draw_function draw;
-	float time_since_last_move;
-	int direction;
-} o[MAXOBJS];
-static int nobjs = 0;
-struct snis_object_pool *obj_pool;
 int openlase_color = GREEN;
 int wallcolor = GREEN;
-static float colorangle = 0.0;
 
 #define SHRINKFACTOR (0.8)
 #define BASICX 100
@@ -129,139 +147,6 @@ struct my_point_t logo_points[] =
 #include "logo-vertices.h"
 struct my_vect_obj logo_vect;
 
-/* get a random number between 0 and n-1... fast and loose algorithm.  */
-static inline int randomn(int n)
-{
-	return random() % n;
-}
-
-static float maze_density(char *maze, int xdim, int ydim)
-{
-	int i, j;
-	float total = 0.0;
-
-	for (i = 0; i < ydim; i++)
-		for (j = 0; j < xdim; j++)
-			if (maze[i * xdim + j] == '#')
-				total = total + 1.0;
-	return total / (float) (xdim * ydim);
-}
-
-static void print_maze(char *maze, int xdim, int ydim)
-{
-	int i, j;
-
-	for (i = 0; i < ydim; i++) {
-		for (j = 0; j < xdim; j++) {
-			if (i == playery && j == playerx) {
-				switch (playerdir) {
-				case 0: printf("^");
-					break;
-				case 1: printf(">");
-					break;
-				case 2: printf("v");
-					break;
-				case 3: printf("<");
-					break;
-				default:
-					printf("?");
-					break;
-				}
-			} else {
-				printf("%c", maze[i * xdim + j]);
-			}
-		}
-		printf("\n");
-	}
-}
-
-#define mazesize(xdim, ydim) \
-	(sizeof(char) * xdim * ydim)
-
-static int inbounds_for_digging(int x, int y, int xdim, int ydim)
-{
-	if (x < 1 || x >= xdim -1 || y < 1 || y >= ydim -1)
-		return 0;
-	return 1;
-}
-
-static int inbounds(int x, int y, int xdim, int ydim)
-{
-	if (x < 0 || x >= xdim || y < 0 || y >= ydim)
-		return 0;
-	return 1;
-}
-
-static int ok_to_dig(char *maze, int x, int y, int direction,
-			int xdim, int ydim)
-{
-	int left, right;
-
-	x += xo[direction];
-	y += yo[direction];
-
-	if (!inbounds_for_digging(x, y, xdim, ydim))
-		return 0;
-	if (maze[y * xdim + x] != '.')
-		return 0;
-	left = direction - 1;
-	if (left < 0)
-		left = 3;
-	if (maze[(y + yo[left]) * xdim + x + xo[left]] != '.')
-		return 0;
-	right = direction + 1;
-	if (right > 3)
-		right = 0;
-	if (maze[(y + yo[right]) * xdim + x + xo[right]] != '.')
-		return 0;
-	return 1;
-}
-
-static void dig(char *maze, int x, int y, int direction, int xdim, int ydim)
-{
-	int left, right;
-
-	maze[y * xdim + x] = '#';
-
-	if (randomn(100) < 7)
-		return;
-
-	if (ok_to_dig(maze, x, y, direction, xdim, ydim))
-		dig(maze, x + xo[direction], y + yo[direction],
-			direction, xdim, ydim);
-	if (randomn(100) < 20) {
-		left = direction - 1;
-		if (left < 0)
-			left = 3;
-		if (ok_to_dig(maze, x, y, left, xdim, ydim))
-			dig(maze, x + xo[left], y + yo[left], left, xdim, ydim);
-	}
-	if (randomn(100) < 20) {
-		right = direction + 1;
-		if (right > 3)
-			right = 0;
-		if (ok_to_dig(maze, x, y, right, xdim, ydim))
-			dig(maze, x + xo[right], y + yo[right], right, xdim, ydim);
-	}
-}
-
-static char *make_maze(int xdim, int ydim, int startx, int starty, int startdir)
-{
-	char *maze;
-	float density;
-
-	for (;;) {
-		maze = malloc(mazesize(xdim, ydim));
-		memset(maze, '.', mazesize(xdim, ydim)); 
-		dig(maze, startx, starty, startdir, xdim, ydim);
-		density = maze_density(maze, xdim, ydim);
-		if (density > 0.30)
-			break;
-		free(maze);
-	}
-	return maze;
-}
-
 static int setup_openlase(void)
 {
 	OLRenderParams params;
@@ -293,26 +178,30 @@ static int setup_openlase(void)
 	return 0;
 }
 
-void draw_vect(struct my_vect_obj *v, int sx, int sy, float scale)
+/* Where v's points land drawn at sx, sy and scale, each lit or a blanked
+ * move to the start of the next stroke.  out needs room for v->npoints,
+ * returns how many there are.
+ */
+static int vect_vertices(struct my_vect_obj *v, int sx, int sy, float scale,
+			struct track_vertex *out)
 {
-	int j;
+	int j, n = 0;
 	int x1, y1, x2, y2;
 
-	if (v->p == NULL)
-		return;
-
 	x1 = sx + v->p[0].x * scale;
 	y1 = sy + v->p[0].y * scale;  
-
-	olBegin(OL_LINESTRIP);
-	olVertex(x1, y1, openlase_color);
+	out[n].x = x1;
+	out[n].y = y1;
+	out[n++].lit = 1;
 
 	for (j = 0; j < v->npoints - 1; j++) {
 		if (v->p[j+1].x == LINE_BREAK) { /* Break in the line segments. */
 			j += 2;
 			x1 = sx + v->p[j].x * scale;
 			y1 = sy + v->p[j].y * scale;  
-			olVertex(x1, y1, C_BLACK);
+			out[n].x = x1;
+			out[n].y = y1;
+			out[n++].lit = 0;
 		}
 		if (v->p[j].x == COLOR_CHANGE) {
 			/* do something here to change colors */
@@ -322,189 +211,307 @@ void draw_vect(struct my_vect_obj *v, int sx, int sy, float scale)
 		}
 		x2 = sx + v->p[j + 1].x * scale; 
 		y2 = sy + v->p[j + 1].y * scale;
-		if (x1 > 0 && y2 > 0)
-			olVertex(x2, y2, openlase_color);
+		if (x1 > 0 && y2 > 0) {
+			out[n].x = x2;
+			out[n].y = y2;
+			out[n++].lit = 1;
+		}
 		x1 = x2;
 		y1 = y2;
 	}
-	olEnd();
+	return n;
 }
 
-void draw_generic(struct object *o, int sx, int sy, float scale)
-{
-	draw_vect(o->v, sx, sy, scale);
-}
-
-static void draw_objects(char *maze, int xdim, int ydim)
+/* Same as vect_vertices(), for art already split into strokes, so there
+ * are no markers to look for.
+ */
+static int stroke_vertices(struct my_vect_obj *v, struct vpack_stroke *s,
+			int nstrokes, int sx, int sy, float scale,
+			struct track_vertex *out)
 {
-	int i, j, x, y;
-
-	x = playerx;
-	y = playery;
-
-	for (i = 0; i < NSTEPS; i++) {
-		for (j = 0; j < nobjs; j++) {
-			if (o[j].level == playerlevel && 
-				x == o[j].x && y == o[j].y) {
-				o->draw(&o[j], 500 - (500 * shrinkfactor[i]),
-						500 + 500 * shrinkfactor[i],
-						 2.0 * shrinkfactor[i]);
+	struct my_point_t *p;
+	int i, j, n = 0;
+	int x1, x2, y2;
+
+	for (i = 0; i < nstrokes; i++) {
+		p = &v->p[s[i].first];
+		x1 = sx + p[0].x * scale;
+		out[n].x = x1;
+		out[n].y = sy + p[0].y * scale;
+		out[n++].lit = i == 0;
+		for (j = 1; j < (int) s[i].npoints; j++) {
+			x2 = sx + p[j].x * scale;
+			y2 = sy + p[j].y * scale;
+			if (x1 > 0 && y2 > 0) {
+				out[n].x = x2;
+				out[n].y = y2;
+				out[n++].lit = 1;
 			}
+			x1 = x2;
 		}
-		x += xo[playerdir];
-		y += yo[playerdir];
-		if (!inbounds(x, y, xdim, ydim))
-			break;
-		if (maze[y * xdim + x] == '.') /* wall */
-			break;
 	}
+	return n;
 }
 
-static void climb_ladder(char *maze)
+static void draw_vertices(struct track_vertex *v, int n, int color)
 {
 	int i;
 
-	requested_button_zero = 0;
-	for (i = 0; i < nobjs; i++) {
-		if (o[i].level != playerlevel)
-			continue;
-		if (o[i].x != playerx)
-			continue;
-		if (o[i].y != playery)
-			continue;
-		if (o[i].v == &up_ladder_vect) {
-			if (playerlevel > 0) {
-				playerlevel--;
-				return;
-			}
-		} else {
-			if (o[i].v == &down_ladder_vect) {
-				if (playerlevel < MAXLEVELS - 1) {
-					playerlevel++;
-					return;
-				}
-			}
-		}
-	}
+	olBegin(OL_LINESTRIP);
+	for (i = 0; i < n; i++)
+		olVertex(v[i].x, v[i].y, v[i].lit ? color : C_BLACK);
+	olEnd();
 }
 
-static void move_player(char *maze, int xdim, int ydim)
+static void draw_vect_points(struct my_vect_obj *v, int sx, int sy,
+				float scale)
 {
-	static unsigned long last_move_usec = 0;
-	static unsigned long last_move_sec = 0;
-	struct timeval tv;
-	int nx, ny, nd, tx, ty, i;
-	int dir;
+	struct track_vertex out[v->npoints];
 
-	nx = playerx;
-	ny = playery;
-	nd = playerdir;
+	frame_points += v->npoints;
+	draw_vertices(out, vect_vertices(v, sx, sy, scale, out),
+			openlase_color);
+}
 
-	gettimeofday(&tv, NULL);
-	if (tv.tv_usec - last_move_usec < 250000 && tv.tv_sec == last_move_sec)
+void draw_vect(struct my_vect_obj *v, int sx, int sy, float scale)
+{
+	/* nothing to draw, and no zero length buffer for it */
+	if (v->p == NULL || v->npoints < 1)
 		return;
+	draw_vect_points(v, sx, sy, scale);
+}
 
-	if (requested_forward) {
-		tx = playerx + xo[playerdir];
-		ty = playery + yo[playerdir];
-		if (!inbounds_for_digging(tx, ty, xdim, ydim))
-			return;
-		if (maze[ty * xdim + tx] == '#') {
-			nx = tx;
-			ny = ty;
-		}
-	}
+static struct my_vect_obj *object_vect[NOBJTYPES] = {
+	[OBJ_ROBOT] = &robot_vect,
+	[OBJ_FIRSTAIDKIT] = &firstaidkit_vect,
+	[OBJ_LASERPISTOL] = &laserpistol_vect,
+	[OBJ_GRENADE] = &grenade_vect,
+	[OBJ_UP_LADDER] = &up_ladder_vect,
+	[OBJ_DOWN_LADDER] = &down_ladder_vect,
+};
 
-	if (requested_backward) {
-		dir = playerdir + 2;
-		if (dir > 3)
-			dir -= 4;	
-		tx = playerx + xo[dir];
-		ty = playery + yo[dir];
-		if (!inbounds_for_digging(tx, ty, xdim, ydim))
-			return;
-		if (maze[ty * xdim + tx] == '#') {
-			nx = tx;
-			ny = ty;
-		}
-	}
+static const char *object_asset[NOBJTYPES] = {
+	[OBJ_ROBOT] = "robot",
+	[OBJ_FIRSTAIDKIT] = "first-aid",
+	[OBJ_LASERPISTOL] = "laser-pistol",
+	[OBJ_GRENADE] = "grenade",
+	[OBJ_UP_LADDER] = "up-ladder",
+	[OBJ_DOWN_LADDER] = "down-ladder",
+};
 
-	if (requested_left) {
-		nd = playerdir - 1;
-		if (nd < 0)
-			nd = 3;
-	}
+/* What a type looks like at one level of detail.  Art from an asset pack
+ * comes split into strokes already, compiled in art gets split by
+ * draw_vect() as it goes.
+ */
+struct object_look {
+	struct my_vect_obj v;
+	struct vpack_stroke *stroke;	/* NULL if compiled in */
+	int nstrokes;
+};
+
+/* Each type's looks, most detailed first.  Only the compiled in art
+ * unless there's an asset pack, which may have simpler versions for
+ * further off.
+ */
+static struct object_look object_lod[NOBJTYPES][VPACK_MAX_LODS];
+static int object_nlods[NOBJTYPES];
+
+/* vpack_open() made sure there are points, and strokes that fit them */
+static void draw_strokes(struct object_look *look, int sx, int sy, float scale)
+{
+	struct track_vertex out[look->v.npoints];
+	int n;
+
+	n = stroke_vertices(&look->v, look->stroke, look->nstrokes,
+				sx, sy, scale, out);
+	frame_points += n;
+	draw_vertices(out, n, openlase_color);
+}
+
+static void draw_look(struct object_look *look, int sx, int sy, float scale)
+{
+	if (look->stroke)
+		draw_strokes(look, sx, sy, scale);
+	else
+		draw_vect(&look->v, sx, sy, scale);
+}
+
+/* How far along the player's line of sight x, y is, or -1 if it isn't on it
+ * or is more than depth cells away.
+ */
+static int sight_depth(int x, int y, int depth)
+{
+	int dx = x - game.playerx;
+	int dy = y - game.playery;
+	int d = dx * xo[game.playerdir] + dy * yo[game.playerdir];
 
-	if (requested_right) {
-		nd = playerdir + 1;
-		if (nd > 3)
-			nd = 0;
+	if (d < 0 || d >= depth)
+		return -1;
+	if (dx != d * xo[game.playerdir] || dy != d * yo[game.playerdir])
+		return -1;
+	return d;
+}
+
+static void draw_object_array(struct level *l, struct object_array *a,
+				struct object_look *look, int nlods, int depth,
+				float alpha)
+{
+	int j, d, pd, lod;
+	float sf;
+
+	for (j = 0; j < a->nobjs; j++) {
+		d = sight_depth(a->x[j], a->y[j], depth);
+		if (d < 0)
+			continue;
+		/* Slide things which moved last tick in from where they were */
+		pd = object_moved_last_step(l, a, j) ?
+			sight_depth(a->px[j], a->py[j], depth) : d;
+		if (pd < 0 || pd == d)
+			sf = shrinkfactor[d];
+		else
+			sf = powf(SHRINKFACTOR, pd + (d - pd) * alpha);
+		/* each step of lod is about half the size on screen */
+		lod = d / 2 < nlods ? d / 2 : nlods - 1;
+		draw_look(&look[lod], 500 - (500 * sf), 500 + 500 * sf,
+				2.0 * sf);
 	}
+}
+
+/* how far we can see */
+static int view_depth(struct corridor_runs *c)
+{
+	int depth = corridor_run(c, game.playerx, game.playery,
+					game.playerdir) + 1;
+
+	return depth > NSTEPS ? NSTEPS : depth;
+}
+
+static void draw_objects(struct corridor_runs *c, float alpha)
+{
+	struct level *l = &game.objs.level[game.playerlevel];
+	int depth = view_depth(c);
+	int t;
+
+	for (t = 0; t < NOBJTYPES; t++)
+		draw_object_array(l, &l->obj[t], object_lod[t],
+					object_nlods[t], depth, alpha);
+}
+
+/* Turn whatever the game did this frame into sparks, if it can be seen */
+static void spawn_effect_particles(struct corridor_runs *c)
+{
+	struct game_effect *e;
+	int i, d, depth = view_depth(c);
+	float sf;
 
-	if (requested_button_zero) /* climb ladder */
-		climb_ladder(maze);
-	
-	if (nx != playerx || ny != playery || nd != playerdir) {
-		playerx = nx;
-		playery = ny;
-		playerdir = nd;
-		last_move_usec = tv.tv_usec;
-		last_move_sec = tv.tv_sec;
-#if 0
-		/* activate this to debug player movement */
-		print_maze(maze, xdim, ydim);
-#endif
+	for (i = 0; i < game.neffects; i++) {
+		e = &game.effect[i];
+		if (e->level != game.playerlevel)
+			continue;
+		d = sight_depth(e->x, e->y, depth);
+		if (d < 0)
+			continue;
+		sf = shrinkfactor[d];
+		if (e->type == EFFECT_BLAST)
+			particles_burst(&particles, SCREEN_WIDTH / 2,
+				SCREEN_HEIGHT / 2, 60, 1200.0 * sf, 0.6);
+		else
+			particles_burst(&particles, SCREEN_WIDTH / 2,
+				SCREEN_HEIGHT / 2, 12, 500.0 * sf, 0.25);
 	}
+	game.neffects = 0;
 }
 
-static void move_objects(char *maze, int xdim, int ydim, float elapsed_time)
+/* All the particles in one linestrip, blanking between them.  If there
+ * are more than the points left this frame allow, every so many get
+ * skipped rather than all the newest, so a burst thins out evenly.
+ */
+static void draw_particles(void)
 {
-	int i;
+	int i, allowed, stride;
+	float x, y;
 
-	move_player(maze, xdim, ydim);
-	
-	for (i = 0; i < nobjs; i++) {
-		o[i].move(&o[i], maze, elapsed_time);
+	allowed = (point_budget - frame_points) / PARTICLE_POINTS;
+	if (particles.n == 0 || allowed <= 0)
+		return;
+	stride = (particles.n + allowed - 1) / allowed;
+
+	olBegin(OL_LINESTRIP);
+	for (i = 0; i < particles.n; i += stride) {
+		x = particles.x[i];
+		y = particles.y[i];
+		olVertex(x, y, C_BLACK);
+		olVertex(x - particles.vx[i] * PARTICLE_STREAK,
+			y - particles.vy[i] * PARTICLE_STREAK, openlase_color);
+		frame_points += PARTICLE_POINTS;
 	}
+	olEnd();
 }
 
-static int update_color(float phase, float factor)
+static int color_component(float angle, float phase, float factor)
 {
   float ca;
 
-  ca = colorangle * M_PI / 180.0;
+  ca = angle * M_PI / 180.0;
   
   return ((int) ((sin(factor * ca + phase) + 1.0) * 128.0)) ;
 }
 
-static void update_linecolor(void)
+/* The line color angle degrees round the color wheel */
+static int line_color(float angle)
 {
 	unsigned char r, g, b;
     
-	colorangle += 0.05;
-	if (colorangle > 360.0)
-		colorangle -= 360.0;
-	r = update_color(0, 3.0);
-	g = update_color(2.0 * M_PI / 3.0, 3);
-	b = update_color(4.0 * M_PI / 3.0, 7);
-	openlase_color = (r << 16) | (g << 8) | b; 
+	r = color_component(angle, 0, 3.0);
+	g = color_component(angle, 2.0 * M_PI / 3.0, 3);
+	b = color_component(angle, 4.0 * M_PI / 3.0, 7);
+	return (r << 16) | (g << 8) | b; 
 }
 
-static void attract_mode(void)
+/* The logo throbbing in and out, 0.02 radians of a sine wave a frame, and
+ * the line color going round 0.05 degrees a frame, both made up front.
+ */
+#define ATTRACT_FRAMES 314	/* once in and out */
+#define ATTRACT_COLORS 7200	/* once round */
+static struct track attract;
+
+static int setup_attract_mode(void)
 {
-	static float thetime = 0.0;
+	struct track_vertex out[logo_vect.npoints];
+	int f, i, n;
 	float sf;
+
+	if (track_setup(&attract, ATTRACT_FRAMES,
+			ATTRACT_FRAMES * logo_vect.npoints, ATTRACT_COLORS))
+		return -1;
+	for (f = 0; f < ATTRACT_FRAMES; f++) {
+		sf = (1.0 + sinf(2.0 * M_PI * (f + 1) / ATTRACT_FRAMES) +
+			1.0) / 4.2;
+		n = vect_vertices(&logo_vect, 500 - 500 * sf,
+				500 + 500 * sf, 2 * sf, out);
+		for (i = 0; i < n; i++)
+			track_vertex(&attract, out[i].x, out[i].y, out[i].lit);
+		track_end_frame(&attract);
+	}
+	for (i = 0; i < ATTRACT_COLORS; i++)
+		attract.color[i] = line_color(360.0 * (i + 1) / ATTRACT_COLORS);
+	return 0;
+}
+
+static void attract_mode(void)
+{
+	static unsigned long frame = 0;
+	struct track_vertex *v;
+	int n;
+
 	if (!attract_mode_active)
 		return;
 
-	thetime += 0.02;
-	if (thetime > M_PI * 2.0)
-		thetime -= M_PI * 2.0;
-
-	sf = (1.0 + sinf(thetime) + 1.0) / 4.2; 
-	draw_vect(&logo_vect, 500 - 500 * sf,
-			500 + 500 * sf, 2 * sf);
-	update_linecolor();
+	n = track_frame(&attract, frame, &v);
+	draw_vertices(v, n, openlase_color);
+	frame_points += logo_vect.npoints;
+	openlase_color = track_color(&attract, frame);
+	frame++;
 }
 
 static float init_shrinkfactor(int n)
@@ -518,19 +525,26 @@ static float init_shrinkfactor(int n)
 	}
 	return f;
 }
+static void laser_line(float x1, float y1, float x2, float y2, int color)
+{
+	olLine(x1, y1, x2, y2, color);
+	frame_points += 2;
+}
+
 /* This is the cheeziest 3d dungeon renderer ever, a re-implementation of what
  * old DOS games like Wizardry and early Ultima games did, 'cept nowadays we
  * can use floats with impunity
  */
-static void draw_maze(char *maze, int xdim, int ydim,
+static void draw_maze(struct corridor_runs *c,
 			int playerx, int playery, int playerdir)
 {
 	int steps = NSTEPS;
+	int ahead = corridor_run(c, playerx, playery, playerdir);
 	int i, x, y, left, right;
 	int x1, y1, x2, y2;
 	int sf;
 
-	wallcolor = levelcolor[playerlevel];
+	wallcolor = levelcolor[game.playerlevel];
 
 	/* draw top of left wall */
 	x = playerx;
@@ -544,27 +558,25 @@ static void draw_maze(char *maze, int xdim, int ydim,
 	if (left < 0)
 		left = 3;	
 	for (i = 0; i < steps; i++) {
-		if (!inbounds(x + xo[left], y + yo[left], xdim, ydim))
-			continue;
-		if (maze[(y + yo[left]) * xdim + x + xo[left]] == '.') {
-			olLine(x1, y1, x2, y2, wallcolor);
+		if (corridor_run(c, x, y, left) == 0) {
+			laser_line(x1, y1, x2, y2, wallcolor);
 		} else {
-			olLine(x1, y2, x2, y2, wallcolor);
-			olLine(x1, SCREEN_HEIGHT - y2, x2,
+			laser_line(x1, y2, x2, y2, wallcolor);
+			laser_line(x1, SCREEN_HEIGHT - y2, x2,
 				SCREEN_HEIGHT - y2, wallcolor);
-			olLine(x2, y2, x2, SCREEN_HEIGHT - y2, wallcolor);
-			olLine(x1, y1, x1, SCREEN_HEIGHT - y1, wallcolor);
+			laser_line(x2, y2, x2, SCREEN_HEIGHT - y2, wallcolor);
+			laser_line(x1, y1, x1, SCREEN_HEIGHT - y1, wallcolor);
 		}
 		x += xo[playerdir];
 		y += yo[playerdir];
-		if (maze[y * xdim + x] == '.') { /* back wall */
-			olLine(x2, y2, SCREEN_WIDTH - x2, y2, wallcolor);
-			olLine(x2, SCREEN_HEIGHT - y2,
+		if (i == ahead) { /* back wall */
+			laser_line(x2, y2, SCREEN_WIDTH - x2, y2, wallcolor);
+			laser_line(x2, SCREEN_HEIGHT - y2,
 				SCREEN_WIDTH - x2, SCREEN_HEIGHT - y2, wallcolor);
 
 			/* FIXME: these next 2 lines sometimes get drawn 2x */
-			olLine(x2, y2, x2, SCREEN_HEIGHT - y2, wallcolor);
-			olLine(SCREEN_WIDTH - x2, y2,
+			laser_line(x2, y2, x2, SCREEN_HEIGHT - y2, wallcolor);
+			laser_line(SCREEN_WIDTH - x2, y2,
 				SCREEN_WIDTH - x2, SCREEN_HEIGHT - y2, wallcolor);
 			break;
 		}
@@ -587,20 +599,18 @@ static void draw_maze(char *maze, int xdim, int ydim,
 	if (right > 3)
 		right = 0;	
 	for (i = 0; i < steps; i++) {
-		if (!inbounds(x + xo[right], y + yo[right], xdim, ydim))
-			continue;
-		if (maze[(y + yo[right]) * xdim + x + xo[right]] == '.') {
-			olLine(x1, y1, x2, y2, wallcolor);
+		if (corridor_run(c, x, y, right) == 0) {
+			laser_line(x1, y1, x2, y2, wallcolor);
 		} else {
-			olLine(x1, y2, x2, y2, wallcolor);
-			olLine(x1, SCREEN_HEIGHT - y2, x2,
+			laser_line(x1, y2, x2, y2, wallcolor);
+			laser_line(x1, SCREEN_HEIGHT - y2, x2,
 				SCREEN_HEIGHT - y2, wallcolor);
-			olLine(x2, y2, x2, SCREEN_HEIGHT - y2, wallcolor);
-			olLine(x1, y1, x1, SCREEN_HEIGHT - y1, wallcolor);
+			laser_line(x2, y2, x2, SCREEN_HEIGHT - y2, wallcolor);
+			laser_line(x1, y1, x1, SCREEN_HEIGHT - y1, wallcolor);
 		}
 		x += xo[playerdir];
 		y += yo[playerdir];
-		if (maze[y * xdim + x] == '.') /* back wall */
+		if (i == ahead) /* back wall */
 			break;
 		x1 = x2;
 		y1 = y2;
@@ -621,13 +631,11 @@ static void draw_maze(char *maze, int xdim, int ydim,
 	if (left < 0)
 		left = 3;	
 	for (i = 0; i < steps; i++) {
-		if (!inbounds(x + xo[left], y + yo[left], xdim, ydim))
-			continue;
-		if (maze[(y + yo[left]) * xdim + x + xo[left]] == '.')
-			olLine(x1, y1, x2, y2, wallcolor);
+		if (corridor_run(c, x, y, left) == 0)
+			laser_line(x1, y1, x2, y2, wallcolor);
 		x += xo[playerdir];
 		y += yo[playerdir];
-		if (maze[y * xdim + x] == '.') /* back wall */
+		if (i == ahead) /* back wall */
 			break;
 		x1 = x2;
 		y1 = y2;
@@ -648,13 +656,11 @@ static void draw_maze(char *maze, int xdim, int ydim,
 	if (right > 3)
 		right = 0;	
 	for (i = 0; i < steps; i++) {
-		if (!inbounds(x + xo[right], y + yo[right], xdim, ydim))
-			continue;
-		if (maze[(y + yo[right]) * xdim + x + xo[right]] == '.')
-			olLine(x1, y1, x2, y2, wallcolor);
+		if (corridor_run(c, x, y, right) == 0)
+			laser_line(x1, y1, x2, y2, wallcolor);
 		x += xo[playerdir];
 		y += yo[playerdir];
-		if (maze[y * xdim + x] == '.') /* back wall */
+		if (i == ahead) /* back wall */
 			break;
 		x1 = x2;
 		y1 = y2;
@@ -664,9 +670,135 @@ static void draw_maze(char *maze, int xdim, int ydim,
 	}
 }
 
-static void openlase_renderframe(float *elapsed_time)
+#define MAP_CELL ((int) (SCREEN_WIDTH / XDIM))	/* screen units per cell */
+#define MAP_TOP ((int) (SCREEN_HEIGHT - YDIM * MAP_CELL) / 2)
+#define MAP_TILES_X ((XDIM + AUTOMAP_TILE - 1) / AUTOMAP_TILE)
+#define MAP_TILES_Y ((YDIM + AUTOMAP_TILE - 1) / AUTOMAP_TILE)
+#define MAP_TILES (MAP_TILES_X * MAP_TILES_Y)
+#define MAP_PLAYER_POINTS 4
+
+/* The walls of the player's level seen so far, from overhead, tiles
+ * nearest the player first until out of points, and the player.
+ */
+static void draw_automap(void)
+{
+	struct automap_tile *t;
+	int order[MAP_TILES], dist[MAP_TILES];
+	int i, j, k, n, line, np, dx, dy, cap;
+	int px, py, left, right;
+
+	for (n = 0; n < MAP_TILES; n++) {
+		dx = (n % MAP_TILES_X) * AUTOMAP_TILE + AUTOMAP_TILE / 2 -
+			game.playerx;
+		dy = (n / MAP_TILES_X) * AUTOMAP_TILE + AUTOMAP_TILE / 2 -
+			game.playery;
+		for (i = n; i > 0 && dist[i - 1] > dx * dx + dy * dy; i--) {
+			order[i] = order[i - 1];
+			dist[i] = dist[i - 1];
+		}
+		order[i] = n;
+		dist[i] = dx * dx + dy * dy;
+	}
+
+	cap = point_budget - frame_points - MAP_PLAYER_POINTS;
+	if (cap > map_points)
+		cap = map_points;
+	wallcolor = levelcolor[game.playerlevel];
+	np = 0;
+	olBegin(OL_LINESTRIP);
+	for (i = 0; i < MAP_TILES; i++) {
+		t = automap_tile(&game.map, game.maze[game.playerlevel],
+				game.playerlevel, order[i] % MAP_TILES_X,
+				order[i] / MAP_TILES_X);
+		if (!t)
+			continue;
+		for (line = 0; line < t->nlines; line++) {
+			j = t->line[line];
+			k = t->line[line + 1];
+			/* the blanked move to its start counts too */
+			if (np + k - j + 1 > cap)
+				goto done;
+			np += k - j + 1;
+			olVertex(t->x[j] * MAP_CELL, MAP_TOP + t->y[j] * MAP_CELL,
+				C_BLACK);
+			for (; j < k; j++)
+				olVertex(t->x[j] * MAP_CELL,
+					MAP_TOP + t->y[j] * MAP_CELL, wallcolor);
+		}
+	}
+done:
+	/* the player, an arrow head pointing the way they're facing */
+	left = (game.playerdir + 3) & 3;
+	right = (game.playerdir + 1) & 3;
+	px = game.playerx * MAP_CELL + MAP_CELL / 2;
+	py = MAP_TOP + game.playery * MAP_CELL + MAP_CELL / 2;
+	olVertex(px + xo[game.playerdir] * MAP_CELL / 2,
+		py + yo[game.playerdir] * MAP_CELL / 2, C_BLACK);
+	olVertex(px + (xo[left] - xo[game.playerdir]) * MAP_CELL / 3,
+		py + (yo[left] - yo[game.playerdir]) * MAP_CELL / 3,
+		openlase_color);
+	olVertex(px + (xo[right] - xo[game.playerdir]) * MAP_CELL / 3,
+		py + (yo[right] - yo[game.playerdir]) * MAP_CELL / 3,
+		openlase_color);
+	olVertex(px + xo[game.playerdir] * MAP_CELL / 2,
+		py + yo[game.playerdir] * MAP_CELL / 2, openlase_color);
+	olEnd();
+	frame_points += np + MAP_PLAYER_POINTS;
+}
+
+static void draw_text(struct font_text *t, int sx, int sy, int color)
+{
+	int line, j;
+
+	olBegin(OL_LINESTRIP);
+	for (line = 0; line < t->nlines; line++) {
+		j = t->line[line];
+		olVertex(sx + t->x[j], sy + t->y[j], C_BLACK);
+		for (; j < t->line[line + 1]; j++)
+			olVertex(sx + t->x[j], sy + t->y[j], color);
+	}
+	olEnd();
+	frame_points += t->npoints + t->nlines;
+}
+
+/* Level and kills along the top.  The strings only change when the
+ * numbers do, so most frames they come straight out of the cache.
+ */
+static void draw_hud(void)
+{
+	struct font_text *t;
+	char text[FONT_MAX_TEXT];
+
+	snprintf(text, sizeof(text), "LEVEL %d", game.playerlevel + 1);
+	t = font_layout(&hud_font, text, HUD_SCALE);
+	draw_text(t, 20, 20, levelcolor[game.playerlevel]);
+	snprintf(text, sizeof(text), "KILLS %lu", game.robots_killed);
+	t = font_layout(&hud_font, text, HUD_SCALE);
+	draw_text(t, SCREEN_WIDTH - 20 - t->width, 20,
+		levelcolor[game.playerlevel]);
+}
+
+/* Without a laser, stand in for it by taking as long as it would */
+static void pace_frame(void)
+{
+	static double next_frame = 0.0;
+	double now = monotonic_time();
+
+	if (next_frame > now)
+		usleep((next_frame - now) * 1000000.0);
+	else
+		next_frame = now;
+	next_frame += 1.0 / 60.0;
+}
+
+static void openlase_renderframe(void)
 {
-	*elapsed_time = olRenderFrame(60);
+	if (!laser_enabled) {
+		pace_frame();
+		return;
+	}
+	olRenderFrame(60);
+	frame_points = 0;
 	olLoadIdentity();
 	olTranslate(-1,1);
 	olScale(XSCALE, YSCALE);
@@ -675,15 +807,15 @@ static void openlase_renderframe(float *elapsed_time)
 static void deal_with_joystick(void)
 {
 	static struct wwvi_js_event jse;
-	int *xaxis, *yaxis, rc, i;
+	int *xaxis, *yaxis, rc, i, before;
 
-	if (joystick_fd < 0)
+	if (!joystick_active)
 		return;
+	before = game_requested_bits(&game);
 
 	xaxis = &jse.stick_x;
         yaxis = &jse.stick_y;
 
-	memset(&jse.button[0], 0, sizeof(jse.button[0]*10));
 	rc = get_joystick_status(&jse);
 	if (rc != 0)
 		return;
@@ -692,297 +824,506 @@ static void deal_with_joystick(void)
 #define XJOYSTICK_THRESHOLD 20000
 #define YJOYSTICK_THRESHOLD 20000
 
-	/* check joystick buttons */
+	/* check joystick buttons.  Go by presses rather than by what's
+	 * held down right now, so a quick tap between two ticks still
+	 * counts.  The requested_button_* flags stay set until acted on.
+	 */
 
 	for (i = 0; i < 11; i++) {
-		if (jse.button[i] == 1) {
+		if (jse.button_pressed[i]) {
 			attract_mode_active = 0;
 		}
 	}
 
-	if (jse.button[0] == 1) {
-		requested_button_zero = 1;
-	} else {
-		requested_button_zero = 0;
-	}
+	if (jse.button_pressed[0])
+		game.requested_button_zero = 1;
+	if (jse.button_pressed[1])
+		game.requested_button_one = 1;
+	if (jse.button_pressed[2])
+		game.requested_button_two = 1;
+	if (jse.button_pressed[3])	/* just how things are shown */
+		automap_active = !automap_active;
+	memset(jse.button_pressed, 0, sizeof(jse.button_pressed));
 
 	if (*xaxis < -XJOYSTICK_THRESHOLD)
-		requested_left = 1;
+		game.requested_left = 1;
 	else
-		requested_left = 0;
+		game.requested_left = 0;
 	if (*xaxis > XJOYSTICK_THRESHOLD)
-		requested_right = 1;
+		game.requested_right = 1;
 	else
-		requested_right = 0;
+		game.requested_right = 0;
 	if (*yaxis < -YJOYSTICK_THRESHOLD)
-		requested_forward = 1;
+		game.requested_forward = 1;
 	else
-		requested_forward = 0;
+		game.requested_forward = 0;
 	if (*yaxis > YJOYSTICK_THRESHOLD)
-		requested_backward = 1;
+		game.requested_backward = 1;
 	else
-		requested_backward = 0;
-}
-
-static void setup_vects(void)
-{
-	setup_vect(robot_vect, robot_points);
-	setup_vect(up_ladder_vect, up_ladder_points);
-	setup_vect(down_ladder_vect, down_ladder_points);
-	setup_vect(firstaidkit_vect, firstaidkit_points);
-	setup_vect(laserpistol_vect, laserpistol_points);
-	setup_vect(grenade_vect, grenade_points);
-	setup_vect(logo_vect, logo_points);
-}
-
-static void robot_move(struct object *o, char *maze, float time)
-{
-	int nx, ny;
-	int count = 0;
-	static float robot_move_time = 1.0;
+		game.requested_backward = 0;
 
-	o->time_since_last_move += time;
-
-	if (o->time_since_last_move < robot_move_time)
-		return;
-
-	o->time_since_last_move = 0.0;
-
-	do {
-		count++;
-
-		if (count > 10) {
-			nx = o->x;
-			ny = o->y;
-			break;
-		}
-
-		nx = o->x + xo[o->direction];
-		ny = o->y + yo[o->direction];
-
-		if (!inbounds(nx, ny, XDIM, YDIM)) {
-			o->direction = randomn(4);
-			continue;
-		}
-
-		if (maze[ny * XDIM + nx] != '#') {
-			o->direction = randomn(4);
-			continue;
-		}
-		break;
-	} while (1);
-	o->x = nx;
-	o->y = ny;
+	/* anything newly asked for is an input worth tracing */
+	if (jse.nevents && (game_requested_bits(&game) & ~before))
+		latency_input(latency_kernel_time(jse.first_event_time,
+					jse.first_event_arrival),
+				jse.first_event_arrival);
 }
 
-static void no_move(__attribute__((unused)) struct object *o,
-			__attribute__((unused)) char *maze,
-			__attribute__((unused)) float time)
-{
-	return;
-}
-
-static void add_firstaidkits(char *maze, int level, int xdim, int ydim, int n)
+/* Input for this tick, from the joystick or from a recording.  When
+ * recording, what gets written is what the joystick changed, not what the
+ * simulation did to the flags afterwards (acting on a button clears it), so
+ * a replay applying just those changes sees exactly the same flags.
+ * Returns -1 once a replay has run out.
+ */
+static int deal_with_input(void)
 {
-	int i, x, y, r;
-
-	for (i = 0; i < n; i++) {
-		do {
-			x = randomn(xdim);
-			y = randomn(ydim);
-		} while (maze[xdim * y + x] != '#');
-		r = snis_object_pool_alloc_obj(obj_pool);
-		nobjs++;
-		o[r].x = x;
-		o[r].y = y;
-		o[r].level = level;
-		o[r].n = r;
-		o[r].alive = 1;
-		o[r].move = no_move;
-		o[r].draw = draw_generic;
-		o[r].v = &firstaidkit_vect;
+	int before, bits, rc;
+
+	if (replaying) {
+		rc = replay_input(game.clock.ticks, &bits);
+		if (rc < 0)
+			return -1;
+		if (rc > 0)
+			game_set_requested_bits(&game, bits);
+		return 0;
 	}
+	before = game_requested_bits(&game);
+	deal_with_joystick();
+	bits = game_requested_bits(&game);
+	/* the flags may have been set while in attract mode */
+	if (record_file && (game.clock.ticks == 0 || bits != before))
+		recording_input(game.clock.ticks, bits);
+	return 0;
 }
 
-static void add_laserpistols(char *maze, int level, int xdim, int ydim, int n)
+/* Use whatever art the pack has in place of what's compiled in */
+static void load_assets(void)
 {
-	int i, x, y, r;
-
-	for (i = 0; i < n; i++) {
-		do {
-			x = randomn(xdim);
-			y = randomn(ydim);
-		} while (maze[xdim * y + x] != '#');
-		r = snis_object_pool_alloc_obj(obj_pool);
-		nobjs++;
-		o[r].x = x;
-		o[r].y = y;
-		o[r].level = level;
-		o[r].n = r;
-		o[r].alive = 1;
-		o[r].move = no_move;
-		o[r].draw = draw_generic;
-		o[r].v = &laserpistol_vect;
+	struct object_look *look;
+	struct vpack_asset *a;
+	int t, i;
+
+	if (vpack_open(&assets, assets_file))
+		exit(1);
+	for (t = 0; t < NOBJTYPES; t++) {
+		a = vpack_find(&assets, object_asset[t]);
+		if (!a)
+			continue;
+		for (i = 0; i < (int) a->nlods; i++) {
+			look = &object_lod[t][i];
+			vpack_vect(&assets, a, i, &look->v);
+			look->stroke = vpack_strokes(&assets, a, i,
+							&look->nstrokes);
+		}
+		object_nlods[t] = a->nlods;
 	}
+	a = vpack_find(&assets, "logo");
+	if (a)
+		vpack_vect(&assets, a, 0, &logo_vect);
 }
 
-static void add_grenades(char *maze, int level, int xdim, int ydim, int n)
+static void setup_vects(void)
 {
-	int i, x, y, r;
+	int t;
 
-	for (i = 0; i < n; i++) {
-		do {
-			x = randomn(xdim);
-			y = randomn(ydim);
-		} while (maze[xdim * y + x] != '#');
-		r = snis_object_pool_alloc_obj(obj_pool);
-		nobjs++;
-		o[r].x = x;
-		o[r].y = y;
-		o[r].level = level;
-		o[r].n = r;
-		o[r].alive = 1;
-		o[r].move = no_move;
-		o[r].draw = draw_generic;
-		o[r].v = &grenade_vect;
+	setup_vect(robot_vect, robot_points);
+	setup_vect(up_ladder_vect, up_ladder_points);
+	setup_vect(down_ladder_vect, down_ladder_points);
+	setup_vect(firstaidkit_vect, firstaidkit_points);
+	setup_vect(laserpistol_vect, laserpistol_points);
+	setup_vect(grenade_vect, grenade_points);
+	setup_vect(logo_vect, logo_points);
+	for (t = 0; t < NOBJTYPES; t++) {
+		object_lod[t][0].v = *object_vect[t];
+		object_lod[t][0].stroke = NULL;
+		object_nlods[t] = 1;
 	}
+	if (assets_file)
+		load_assets();
+	font_setup();
+	font_cache_init(&hud_font);
 }
 
-
-static void add_robots(char *maze, int level, int xdim, int ydim, int nrobots)
+/* Every stats_interval seconds, how the object pool is doing */
+static void dump_stats(int final)
 {
-	int i;
-	int x, y;
-	int r;
-
-
-	for (i = 0; i < nrobots; i++) {
-		do {
-			x = randomn(xdim);
-			y = randomn(ydim);
-		} while (maze[xdim * y + x] != '#');
-		r = snis_object_pool_alloc_obj(obj_pool);
-		nobjs++;
-		o[r].x = x;
-		o[r].y = y;
-		o[r].level = level;
-		o[r].n = r;
-		o[r].alive = 1;
-		o[r].move = robot_move;
-		o[r].draw = draw_generic;
-		o[r].v = &robot_vect;
+	static struct snis_object_pool_stats last;
+	static double last_time = 0.0;
+	struct snis_object_pool_stats st;
+	double now = monotonic_time();
+	double dt = now - last_time;
+	unsigned long allocs;
+
+	if (!final && last_time != 0.0 && dt < stats_interval)
+		return;
+	snis_object_pool_stats(game.objs.pool, &st);
+	if (last_time == 0.0) {
+		last = st;
+		last_time = now;
+		return;
 	}
+	allocs = st.allocs - last.allocs;
+	printf("objects: %d live, %d high water, highest id %d, "
+		"%.0f%% fragmented, %.1f allocs/s, %.1f frees/s, "
+		"%.2f words scanned per alloc\n",
+		st.live, st.high_water, st.highest,
+		snis_object_pool_fragmentation(&st) * 100.0,
+		allocs / dt, (st.frees - last.frees) / dt,
+		allocs ? (double) (st.scan - last.scan) / allocs : 0.0);
+	last = st;
+	last_time = now;
 }
 
-static void create_ladder(int x, int y, int level, struct my_vect_obj *v)
-{
-	int l;
-
-	l = snis_object_pool_alloc_obj(obj_pool);
-	nobjs++;
-	o[l].x = x;
-	o[l].y = y;
-	o[l].level = level;
-	o[l].n = l;
-	o[l].alive = 1;
-	o[l].move = no_move;
-	o[l].draw = draw_generic;
-	o[l].v = v;
-}
-
-static void create_up_ladder(int x, int y, int level)
+static void quit_handler(__attribute__((unused)) int sig)
 {
-	create_ladder(x, y, level, &up_ladder_vect);
+	time_to_quit = 1;
 }
 
-static void create_down_ladder(int x, int y, int level)
+static void usage(void)
 {
-	create_ladder(x, y, level, &down_ladder_vect);
+	struct game_config d;
+
+	game_default_config(&d);
+	fprintf(stderr, "usage: mazers-n-lasers [options]\n"
+		"  --offlevel=full|batched|arrival\n"
+		"        how to simulate levels the player isn't on (default batched)\n"
+		"  --offlevel-interval=seconds\n"
+		"        least game time between batched ticks of an off-level robot's\n"
+		"        level, fewer when there are lots of levels (default 5)\n"
+		"  --catchup-moves=n\n"
+		"        most moves a robot makes in one batched tick (default 20)\n"
+		"  --tick-rate=hz\n"
+		"        simulation ticks per second (default %d)\n"
+		"  --latency\n"
+		"        trace input to photon latency, report percentiles on exit\n"
+		"  --inject-input=hz\n"
+		"        use made up joystick input, about hz events a second\n"
+		"  --no-laser\n"
+		"        don't draw anything, just take as long as the laser would\n"
+		"  --frames=n\n"
+		"        quit after n frames\n"
+		"  --point-budget=n\n"
+		"        about how many points the laser can draw in a frame,\n"
+		"        extras like sparks are cut back to fit (default %d)\n"
+		"  --automap\n"
+		"        start off showing the map rather than the view, joystick\n"
+		"        button 3 switches between them\n"
+		"  --map-points=n\n"
+		"        most points of map to show around the player (default %d)\n"
+		"  --assets=file\n"
+		"        draw things with the art in an asset pack made by mkvpack\n"
+		"        rather than what's built in\n"
+		"  --robots=n\n"
+		"        robots per level (default %d)\n"
+		"  --max-objects=n\n"
+		"        most objects there can be in the game at once (default %d)\n"
+		"  --stats=seconds\n"
+		"        print object pool statistics this often\n"
+		"  --seed=n\n"
+		"        random seed, for making the same mazes again\n"
+		"  --record=file\n"
+		"        record the seed, settings and input to file\n"
+		"  --replay=file\n"
+		"        rerun a recording as fast as possible, without a laser,\n"
+		"        and report how long the simulation took per tick\n"
+		"  --batch=n\n"
+		"        no laser, no joystick: play n games with robot players,\n"
+		"        seeds counting up from --seed, and report how fast they ran\n"
+		"  --threads=n\n"
+		"        how many games to run at once in batch mode (default, one\n"
+		"        per cpu)\n"
+		"  --batch-ticks=n\n"
+		"        how long each batch game runs, in ticks (default ten\n"
+		"        minutes of game time)\n",
+		d.sim_hz, DEFAULT_POINT_BUDGET, DEFAULT_MAP_POINTS, d.nrobots,
+		d.maxobjs);
+	exit(1);
 }
 
-static void add_ladders(char *uppermaze, char *lowermaze, int lowerlevel, int xdim, int ydim)
+static void parse_options(int argc, char *argv[])
 {
-	int i, j, x, y;
-	int down, up;
-	int bad_spot;
-
-	for (i = 0; i < LADDERS_BETWEEN_LEVELS; i++) {
-		do {
-			x = randomn(xdim);
-			y = randomn(ydim) ;
-		} while (uppermaze[xdim * y + x] != '#' ||
-			lowermaze[xdim * y + x] != '#');
-
-		bad_spot = 0;
-		for (j = 0; j < nobjs; j++) {
-			if (x == o[j].x && y == o[j].y &&
-				(o[j].level == lowerlevel || 
-				o[j].level == lowerlevel - 1)) {
-				bad_spot = 1;
-				break;
-			}
+	static struct option long_options[] = {
+		{ "offlevel", required_argument, NULL, 'o' },
+		{ "offlevel-interval", required_argument, NULL, 'i' },
+		{ "catchup-moves", required_argument, NULL, 'c' },
+		{ "tick-rate", required_argument, NULL, 't' },
+		{ "latency", no_argument, NULL, 'l' },
+		{ "inject-input", required_argument, NULL, 'j' },
+		{ "no-laser", no_argument, NULL, 'n' },
+		{ "frames", required_argument, NULL, 'f' },
+		{ "point-budget", required_argument, NULL, 'P' },
+		{ "automap", no_argument, NULL, 'a' },
+		{ "map-points", required_argument, NULL, 'M' },
+		{ "assets", required_argument, NULL, 'A' },
+		{ "robots", required_argument, NULL, 'R' },
+		{ "max-objects", required_argument, NULL, 'm' },
+		{ "stats", required_argument, NULL, 'S' },
+		{ "seed", required_argument, NULL, 's' },
+		{ "record", required_argument, NULL, 'r' },
+		{ "replay", required_argument, NULL, 'p' },
+		{ "batch", required_argument, NULL, 'b' },
+		{ "threads", required_argument, NULL, 'T' },
+		{ "batch-ticks", required_argument, NULL, 'k' },
+		{ "help", no_argument, NULL, 'h' },
+		{ 0, 0, 0, 0 },
+	};
+	int c;
+
+	while ((c = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+		switch (c) {
+		case 'o':
+			if (strcmp(optarg, "full") == 0)
+				config.lod.mode = SIM_LOD_FULL;
+			else if (strcmp(optarg, "batched") == 0)
+				config.lod.mode = SIM_LOD_BATCHED;
+			else if (strcmp(optarg, "arrival") == 0)
+				config.lod.mode = SIM_LOD_ON_ARRIVAL;
+			else
+				usage();
+			break;
+		case 'i':
+			config.lod.batch_interval = atof(optarg);
+			if (config.lod.batch_interval <= 0.0)
+				usage();
+			break;
+		case 'c':
+			config.lod.max_catchup_moves = atoi(optarg);
+			if (config.lod.max_catchup_moves < 1)
+				usage();
+			break;
+		case 't':
+			config.sim_hz = atoi(optarg);
+			if (config.sim_hz < 1 || config.sim_hz > 1000)
+				usage();
+			break;
+		case 'l':
+			latency_tracing = 1;
+			break;
+		case 'j':
+			inject_input_hz = atof(optarg);
+			if (inject_input_hz <= 0.0)
+				usage();
+			break;
+		case 'n':
+			laser_enabled = 0;
+			break;
+		case 'f':
+			max_frames = strtoul(optarg, NULL, 10);
+			break;
+		case 'P':
+			point_budget = atoi(optarg);
+			if (point_budget < 1)
+				usage();
+			break;
+		case 'a':
+			automap_active = 1;
+			break;
+		case 'M':
+			map_points = atoi(optarg);
+			if (map_points < 1)
+				usage();
+			break;
+		case 'A':
+			assets_file = optarg;
+			break;
+		case 'R':
+			config.nrobots = atoi(optarg);
+			if (config.nrobots < 0)
+				usage();
+			break;
+		case 'm':
+			config.maxobjs = atoi(optarg);
+			if (config.maxobjs < 1)
+				usage();
+			break;
+		case 'S':
+			stats_interval = atof(optarg);
+			if (stats_interval <= 0.0)
+				usage();
+			break;
+		case 's':
+			config.seed = strtoul(optarg, NULL, 0);
+			seed_given = 1;
+			break;
+		case 'r':
+			record_file = optarg;
+			break;
+		case 'p':
+			replay_file = optarg;
+			break;
+		case 'b':
+			batch_sessions = atoi(optarg);
+			if (batch_sessions < 1)
+				usage();
+			break;
+		case 'T':
+			batch_threads = atoi(optarg);
+			if (batch_threads < 1)
+				usage();
+			break;
+		case 'k':
+			batch_ticks = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			usage();
 		}
-		if (bad_spot)
-			continue;
-		create_up_ladder(x, y, lowerlevel);
-		create_down_ladder(x, y, lowerlevel - 1); 
 	}
 }
 
 int main(int argc, char *argv[])
 {
-	char *maze[MAXLEVELS];
 	struct timeval tv;
-	float elapsed_time = 0.0;
-	int xdim = XDIM;
-	int ydim = YDIM;
-	int i;
+	struct replay_header header;
+	struct corridor_runs *runs;
+	int i, n;
+	unsigned long frame;
+	double t, last_frame;
+
+	game_default_config(&config);
+	parse_options(argc, argv);
+
+	if (!seed_given) {
+		gettimeofday(&tv, NULL);
+		config.seed = tv.tv_usec;
+	}
+	if (batch_sessions)
+		return run_batch(&config, batch_sessions, batch_threads,
+				batch_ticks) ? -1 : 0;
 
 	init_shrinkfactor(NSTEPS);
 	setup_vects();
 
-	gettimeofday(&tv, NULL);
-	srand(tv.tv_usec);
-
-	snis_object_pool_setup(&obj_pool, MAXOBJS);
-
-	joystick_fd = open_joystick(JOYSTICK_DEVICE, NULL);
-	if (joystick_fd < 0)
-		printf("No joystick...");
-
+	if (replay_file && record_file) {
+		fprintf(stderr, "Can't record and replay at the same time\n");
+		return -1;
+	}
+	if (replay_file) {
+		if (replay_open(replay_file, &header)) {
+			fprintf(stderr, "Can't replay %s\n", replay_file);
+			return -1;
+		}
+		replaying = 1;
+		laser_enabled = 0;
+		attract_mode_active = 0;
+		config.seed = header.seed;
+		config.sim_hz = header.sim_hz;
+		config.lod.mode = header.lod_mode;
+		config.lod.batch_interval = header.batch_interval;
+		config.lod.max_catchup_moves = header.max_catchup_moves;
+		config.nrobots = header.nrobots;
+	}
+	if (record_file) {
+		header.seed = config.seed;
+		header.sim_hz = config.sim_hz;
+		header.lod_mode = config.lod.mode;
+		header.batch_interval = config.lod.batch_interval;
+		header.max_catchup_moves = config.lod.max_catchup_moves;
+		header.nrobots = config.nrobots;
+		if (recording_start(record_file, &header)) {
+			fprintf(stderr, "Can't record to %s\n", record_file);
+			return -1;
+		}
+	}
 
-	playerx = xdim / 2;
-	playery = ydim - 2;
-	playerdir = 0;
-	playerlevel = 0;
-	for (i = 0; i < MAXLEVELS; i++) {
-		maze[i] = make_maze(xdim, ydim, playerx, playery, playerdir);
-		print_maze(maze[i], xdim, ydim);
-		printf("density = %f\n", maze_density(maze[i], xdim, ydim));
-		add_robots(maze[i], i, xdim, ydim, nrobots);
-		add_firstaidkits(maze[i], i, xdim, ydim, nfirstaidkits);
-		add_laserpistols(maze[i], i, xdim, ydim, nlaserpistols);
-		add_grenades(maze[i], i, xdim, ydim, ngrenades);
+	if (replaying) {
+		/* input comes from the recording */
+	} else if (inject_input_hz > 0.0) {
+		if (start_joystick_injector(inject_input_hz) == 0)
+			joystick_active = 1;
+	} else {
+		joystick_fd = open_joystick(JOYSTICK_DEVICE, NULL);
+		if (joystick_fd < 0)
+			printf("No joystick...");
+		else if (start_joystick_thread())
+			printf("No joystick input thread, polling joystick instead\n");
+		joystick_active = joystick_fd >= 0;
 	}
+	if (latency_tracing)
+		latency_enable();
 
-	for (i = 0; i < MAXLEVELS - 1; i++)
-		add_ladders(maze[i], maze[i + 1], i + 1, xdim, ydim);
+	config.print_mazes = 1;
+	if (game_setup(&game, &config))
+		return -1;
 
-	if (setup_openlase())
+	if (laser_enabled && (setup_openlase() || setup_attract_mode()))
+		return -1;
+	/* never more particles than there'd be points to draw */
+	if (particles_setup(&particles, point_budget / PARTICLE_POINTS))
 		return -1;
 
-	for (;;) {
-		deal_with_joystick();
+	signal(SIGINT, quit_handler);
+	signal(SIGTERM, quit_handler);
+
+	last_frame = monotonic_time();
+	for (frame = 0; !time_to_quit; frame++) {
+		if (max_frames && frame >= max_frames)
+			break;
 		if (attract_mode_active) {
-			attract_mode();
-			openlase_renderframe(&elapsed_time);
+			deal_with_joystick();
+			if (laser_enabled)
+				attract_mode();
+			openlase_renderframe();
+			sim_clock_hold(&game.clock);
 			continue;
 		}
-		draw_maze(maze[playerlevel], xdim, ydim, playerx, playery, playerdir);
-		draw_objects(maze[playerlevel], xdim, ydim);
-		openlase_renderframe(&elapsed_time);
-		move_objects(maze[playerlevel], xdim, ydim, elapsed_time);
+		n = replaying ? 1 : sim_clock_ticks_due(&game.clock);
+		for (i = 0; i < n; i++) {
+			if (deal_with_input() < 0) {
+				time_to_quit = 1;
+				break;
+			}
+			t = monotonic_time();
+			/* an input held back till the player can move
+			 * again stays traced, that wait is lag too
+			 */
+			switch (game_tick(&game)) {
+			case GAME_TICK_MOVED:
+				latency_applied(monotonic_time());
+				break;
+			case GAME_TICK_IDLE:
+				latency_cancel();
+				break;
+			}
+			if (replaying)
+				replay_tick_cost(monotonic_time() - t);
+		}
+		if (replaying)
+			continue;
+		runs = &game.objs.level[game.playerlevel].runs;
+		spawn_effect_particles(runs);
+		t = monotonic_time();
+		particles_move(&particles, t - last_frame);
+		last_frame = t;
+		if (laser_enabled && automap_active) {
+			draw_hud();
+			draw_automap();
+		} else if (laser_enabled) {
+			draw_maze(runs, game.playerx, game.playery, game.playerdir);
+			draw_objects(runs, sim_clock_alpha(&game.clock));
+			draw_hud();
+			draw_particles();
+		}
+		openlase_renderframe();
+		latency_frame(monotonic_time());
+		if (stats_interval > 0.0)
+			dump_stats(0);
+	}
+	if (stats_interval > 0.0)
+		dump_stats(1);
+	stop_joystick_thread();
+	if (record_file) {
+		recording_stop(game.clock.ticks, game_checksum(&game));
+		printf("recorded %lu ticks, seed %u, world checksum %08x\n",
+			game.clock.ticks, config.seed, game_checksum(&game));
 	}
-	olShutdown();
+	if (replaying)
+		replay_report(stdout, game.clock.ticks, game_checksum(&game));
+	latency_report(stdout);
+	particles_free(&particles);
+	track_free(&attract);
+	vpack_close(&assets);
+	game_free(&game);
+	if (laser_enabled)
+		olShutdown();
 	return 0;
 }
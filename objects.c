@@ -0,0 +1,1188 @@
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "maze.h"
+#include "objects.h"
+#include "snis_alloc.h"
+
+#define ROBOT_MOVE_TIME 1.0	/* seconds per move, unless set otherwise */
+#define DEFAULT_MAX_ROBOT_MOVES 20
+#define CATCHUP_LEGS 2		/* straight runs a robot makes catching up */
+#define BATCH_CREDIT_MAX (1 << 30)
+#define ROBOT_HUNT_RADIUS 24	/* steps away a robot can find the player from */
+#define OCCUPIED_WORDS ((XDIM * YDIM + 63) / 64)
+
+static void wake_robots(struct object_store *s, struct level *l, int first,
+				unsigned int to);
+
+/* Types that wait on the wheel to move, each with a loop in fire_slot() */
+static const unsigned char type_wakes[NOBJTYPES] = {
+	[OBJ_ROBOT] = 1,
+};
+
+const unsigned char object_type_class[NOBJTYPES] = {
+	[OBJ_ROBOT] = CLASS_ROBOT,
+	[OBJ_FIRSTAIDKIT] = CLASS_ITEM,
+	[OBJ_LASERPISTOL] = CLASS_ITEM,
+	[OBJ_GRENADE] = CLASS_ITEM,
+	[OBJ_UP_LADDER] = CLASS_LADDER,
+	[OBJ_DOWN_LADDER] = CLASS_LADDER,
+};
+
+static float default_move_time[NOBJTYPES] = {
+	[OBJ_ROBOT] = ROBOT_MOVE_TIME,
+};
+
+int object_store_setup(struct object_store *s, int nlevels, int maxobjs)
+{
+	int i;
+
+	memset(s, 0, sizeof(*s));
+	s->level = malloc(sizeof(*s->level) * nlevels);
+	s->slot = calloc((maxobjs >> SLOT_CHUNK_SHIFT) + 1, sizeof(*s->slot));
+	if (!s->level || !s->slot) {
+		free(s->level);
+		free(s->slot);
+		return -1;
+	}
+	memset(s->level, 0, sizeof(*s->level) * nlevels);
+	for (i = 0; i < nlevels; i++) {
+		s->level[i].simulated = 1;
+		s->level[i].flow.tx = -1;
+		s->level[i].flow.ty = -1;
+		memset(s->level[i].wheel.slot, 0xff,
+			sizeof(s->level[i].wheel.slot));
+	}
+	s->nlevels = nlevels;
+	s->maxobjs = maxobjs;
+	s->lod.mode = SIM_LOD_FULL;
+	s->lod.batch_interval = 5.0;
+	s->lod.max_catchup_moves = DEFAULT_MAX_ROBOT_MOVES;
+	snis_object_pool_setup(&s->pool, maxobjs);
+	return 0;
+}
+
+/* The cell index is a doubly linked list per maze cell threaded through
+ * the slot table, so objects come and go and move in O(1).  Alongside
+ * it, a bitmap per class of which cells have any of that class in, for
+ * the questions that are only yes or no.
+ */
+static void cell_link(struct object_store *s, struct level *l, int n,
+			int x, int y)
+{
+	struct object_slot *slot = object_store_slot(s, n);
+	int bit = y * XDIM + x;
+	int *first;
+
+	if (!l->cell)
+		return;
+	first = &l->cell[bit];
+	slot->cell_prev = -1;
+	slot->cell_next = *first;
+	if (*first >= 0)
+		object_store_slot(s, *first)->cell_prev = n;
+	*first = n;
+	l->occupied[object_type_class[slot->type]][bit >> 6] |=
+						1ULL << (bit & 63);
+}
+
+static void cell_unlink(struct object_store *s, struct level *l, int n,
+			int x, int y)
+{
+	struct object_slot *slot = object_store_slot(s, n);
+	int bit = y * XDIM + x;
+	int class, o;
+
+	if (!l->cell)
+		return;
+	if (slot->cell_prev >= 0)
+		object_store_slot(s, slot->cell_prev)->cell_next = slot->cell_next;
+	else
+		l->cell[bit] = slot->cell_next;
+	if (slot->cell_next >= 0)
+		object_store_slot(s, slot->cell_next)->cell_prev = slot->cell_prev;
+
+	/* the bit stays if anything else of the class is still there */
+	class = object_type_class[slot->type];
+	for (o = l->cell[bit]; o >= 0; o = object_store_slot(s, o)->cell_next)
+		if (object_type_class[object_store_slot(s, o)->type] == class)
+			return;
+	l->occupied[class][bit >> 6] &= ~(1ULL << (bit & 63));
+}
+
+int object_store_find_in_cell(struct object_store *s, int level,
+				int x, int y, unsigned int types)
+{
+	struct level *l = &s->level[level];
+	int n;
+
+	if (!l->cell || !inbounds(x, y, XDIM, YDIM))
+		return -1;
+	for (n = l->cell[y * XDIM + x]; n >= 0;
+			n = object_store_slot(s, n)->cell_next)
+		if (types & (1u << object_store_slot(s, n)->type))
+			return n;
+	return -1;
+}
+
+static inline void move_object(struct object_store *s, struct level *l,
+				struct object_array *a, int i, int x, int y)
+{
+	cell_unlink(s, l, a->n[i], a->x[i], a->y[i]);
+	a->x[i] = x;
+	a->y[i] = y;
+	cell_link(s, l, a->n[i], x, y);
+}
+
+static void timer_link(struct object_store *s, struct timer_wheel *w, int n,
+			unsigned int wake)
+{
+	struct object_slot *slot = object_store_slot(s, n);
+	unsigned int delta = wake - w->now;
+	int lvl, *first;
+
+	if (delta >= 1u << (WHEEL_BITS * WHEEL_LEVELS)) {
+		delta = (1u << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+		wake = w->now + delta;
+	}
+	for (lvl = 0; lvl < WHEEL_LEVELS - 1; lvl++)
+		if (delta < 1u << (WHEEL_BITS * (lvl + 1)))
+			break;
+	slot->wake = wake;
+	slot->timer_slot = lvl * WHEEL_SLOTS +
+		((wake >> (WHEEL_BITS * lvl)) & (WHEEL_SLOTS - 1));
+	first = &w->slot[slot->timer_slot];
+	w->busy[lvl] |= 1ULL << (slot->timer_slot & (WHEEL_SLOTS - 1));
+	slot->timer_prev = -1;
+	slot->timer_next = *first;
+	if (*first >= 0)
+		object_store_slot(s, *first)->timer_prev = n;
+	*first = n;
+	w->ntimers++;
+}
+
+static void timer_unlink(struct object_store *s, struct timer_wheel *w, int n)
+{
+	struct object_slot *slot = object_store_slot(s, n);
+
+	if (slot->timer_slot < 0)
+		return;
+	if (slot->timer_prev >= 0)
+		object_store_slot(s, slot->timer_prev)->timer_next =
+							slot->timer_next;
+	else
+		w->slot[slot->timer_slot] = slot->timer_next;
+	if (w->slot[slot->timer_slot] < 0)
+		w->busy[slot->timer_slot / WHEEL_SLOTS] &=
+			~(1ULL << (slot->timer_slot & (WHEEL_SLOTS - 1)));
+	if (slot->timer_next >= 0)
+		object_store_slot(s, slot->timer_next)->timer_prev =
+							slot->timer_prev;
+	slot->timer_slot = -1;
+	w->ntimers--;
+}
+
+/* Take everything off a wheel slot, returning the first of them */
+static int timer_take_slot(struct object_store *s, struct timer_wheel *w,
+				int index)
+{
+	int n, first = w->slot[index];
+
+	w->slot[index] = -1;
+	w->busy[index / WHEEL_SLOTS] &= ~(1ULL << (index & (WHEEL_SLOTS - 1)));
+	for (n = first; n >= 0; n = object_store_slot(s, n)->timer_next) {
+		object_store_slot(s, n)->timer_slot = -1;
+		w->ntimers--;
+	}
+	return first;
+}
+
+/* How many of a[i]'s periods are up by wheel tick to, having come due
+ * now, and set it going again for the first one after that.
+ */
+static inline int timer_refire(struct object_store *s, struct level *l,
+				struct object_array *a, int i, unsigned int to)
+{
+	int period = a->period[i];
+	int due = 1 + (to - l->wheel.now) / period;
+
+	timer_link(s, &l->wheel, a->n[i], l->wheel.now + due * period);
+	return due;
+}
+
+/* Wake everything on a slot that's come due, sorted out by type first so
+ * each type's loop gets called directly, once, rather than an indirect
+ * call per object.  Returns how many there were.
+ */
+static int fire_slot(struct object_store *s, struct level *l, int first,
+			unsigned int to)
+{
+	struct object_slot *slot;
+	int head[NOBJTYPES], *tail[NOBJTYPES];
+	int n, t, fired = 0;
+
+	for (t = 0; t < NOBJTYPES; t++) {
+		head[t] = -1;
+		tail[t] = &head[t];
+	}
+	for (n = first; n >= 0; n = slot->timer_next) {
+		slot = object_store_slot(s, n);
+		*tail[slot->type] = n;
+		tail[slot->type] = &slot->timer_next;
+		fired++;
+	}
+	for (t = 0; t < NOBJTYPES; t++)
+		*tail[t] = -1;
+
+	if (head[OBJ_ROBOT] >= 0)
+		wake_robots(s, l, head[OBJ_ROBOT], to);
+	return fired;
+}
+
+/* Ticks from now until the next one with anything to do: a slot on the
+ * smallest wheel with something on, or that wheel coming round.
+ */
+static unsigned int wheel_next(struct timer_wheel *w)
+{
+	unsigned int index = w->now & (WHEEL_SLOTS - 1);
+	uint64_t later = index == WHEEL_SLOTS - 1 ? 0 :
+				w->busy[0] >> (index + 1);
+
+	if (later)
+		return __builtin_ctzll(later) + 1;
+	return WHEEL_SLOTS - index;
+}
+
+/* Move the level's wheel on to tick to, in order, skipping the ticks with
+ * nothing on.  Whenever a wheel comes round, the next slot of the one
+ * above gets spread down onto it, biggest wheel first.  Returns how many
+ * things came due.
+ */
+static int wheel_advance(struct object_store *s, struct level *l,
+				unsigned int to)
+{
+	struct timer_wheel *w = &l->wheel;
+	int lvl, index, n, next, fired = 0;
+	unsigned int skip;
+
+	while ((int) (to - w->now) > 0) {
+		skip = wheel_next(w);
+		if (!w->ntimers || skip > to - w->now) {
+			w->now = to;
+			break;
+		}
+		w->now += skip;
+		for (lvl = WHEEL_LEVELS - 1; lvl > 0; lvl--) {
+			if (w->now & ((1u << (WHEEL_BITS * lvl)) - 1))
+				continue;
+			index = lvl * WHEEL_SLOTS +
+				((w->now >> (WHEEL_BITS * lvl)) & (WHEEL_SLOTS - 1));
+			for (n = timer_take_slot(s, w, index); n >= 0; n = next) {
+				next = object_store_slot(s, n)->timer_next;
+				timer_link(s, w, n, object_store_slot(s, n)->wake);
+			}
+		}
+		/* Waking things mustn't remove other objects: the rest of
+		 * this slot is already off the wheel, unlinking from it would
+		 * go wrong.
+		 */
+		n = timer_take_slot(s, w, w->now & (WHEEL_SLOTS - 1));
+		if (n >= 0)
+			fired += fire_slot(s, l, n, to);
+	}
+	return fired;
+}
+
+int object_store_set_maze(struct object_store *s, int level, char *maze)
+{
+	struct level *l = &s->level[level];
+	struct object_array *a;
+	int i, t, c;
+
+	l->maze = maze;
+	corridor_runs_free(&l->runs);
+	if (corridor_runs_setup(&l->runs, maze, XDIM, YDIM))
+		return -1;
+	if (!l->cell) {
+		l->cell = malloc(sizeof(*l->cell) * XDIM * YDIM);
+		if (!l->cell)
+			return -1;
+		for (c = 0; c < NCLASSES; c++) {
+			l->occupied[c] = calloc(OCCUPIED_WORDS,
+						sizeof(*l->occupied[c]));
+			if (!l->occupied[c])
+				return -1;
+		}
+	}
+	memset(l->cell, 0xff, sizeof(*l->cell) * XDIM * YDIM);
+	for (c = 0; c < NCLASSES; c++)
+		memset(l->occupied[c], 0, sizeof(*l->occupied[c]) * OCCUPIED_WORDS);
+	for (t = 0; t < NOBJTYPES; t++) {
+		a = &l->obj[t];
+		for (i = 0; i < a->nobjs; i++)
+			cell_link(s, l, a->n[i], a->x[i], a->y[i]);
+	}
+	return 0;
+}
+
+void object_store_set_cell(struct object_store *s, int level, int x, int y,
+				char v)
+{
+	struct level *l = &s->level[level];
+	int tx = l->flow.tx, ty = l->flow.ty;
+
+	if (l->runs.run[0])
+		corridor_runs_set_cell(&l->runs, l->maze, x, y, v);
+	else if (inbounds(x, y, XDIM, YDIM))
+		l->maze[y * XDIM + x] = v;
+	/* the way to the player may have opened up or closed off */
+	if (tx >= 0) {
+		flow_field_clear(&l->flow);
+		flow_field_update(&l->flow, l->maze, tx, ty);
+	}
+}
+
+static void object_array_free(struct object_array *a)
+{
+	free(a->n);
+	free(a->x);
+	free(a->y);
+	free(a->px);
+	free(a->py);
+	free(a->direction);
+	free(a->period);
+	free(a->moved);
+}
+
+void object_store_free(struct object_store *s)
+{
+	int i, t;
+
+	for (i = 0; i < s->nlevels; i++) {
+		for (t = 0; t < NOBJTYPES; t++)
+			object_array_free(&s->level[i].obj[t]);
+		flow_field_free(&s->level[i].flow);
+		corridor_runs_free(&s->level[i].runs);
+		free(s->level[i].cell);
+		for (t = 0; t < NCLASSES; t++)
+			free(s->level[i].occupied[t]);
+	}
+	free(s->level);
+	for (i = 0; i <= s->maxobjs >> SLOT_CHUNK_SHIFT; i++)
+		free(s->slot[i]);
+	free(s->slot);
+	snis_object_pool_free(s->pool);
+	free(s->pool);
+	memset(s, 0, sizeof(*s));
+}
+
+static int grow_field(void **field, size_t elsize, int newsize)
+{
+	void *p;
+
+	p = realloc(*field, elsize * newsize);
+	if (!p)
+		return -1;
+	*field = p;
+	return 0;
+}
+
+#define grow(a, f, newsize) grow_field((void **) &(a)->f, sizeof(*(a)->f), newsize)
+
+static int object_array_append(struct object_array *a)
+{
+	int newsize;
+
+	if (a->nobjs >= a->size) {
+		newsize = a->size ? a->size * 2 : 16;
+		if (grow(a, n, newsize) || grow(a, x, newsize) ||
+			grow(a, y, newsize) || grow(a, px, newsize) ||
+			grow(a, py, newsize) || grow(a, direction, newsize) ||
+			grow(a, period, newsize) || grow(a, moved, newsize))
+			return -1;
+		a->size = newsize;
+	}
+	return a->nobjs++;
+}
+
+int object_store_add(struct object_store *s, int level,
+			enum object_type type, int x, int y)
+{
+	struct object_slot **chunk;
+	struct object_slot *slot;
+	struct level *l;
+	struct object_array *a;
+	int n, i;
+
+	if (level < 0 || level >= s->nlevels)
+		return -1;
+	n = snis_object_pool_alloc_obj(s->pool);
+	if (n < 0)
+		return -1;
+	chunk = &s->slot[n >> SLOT_CHUNK_SHIFT];
+	if (!*chunk) {
+		*chunk = malloc(sizeof(**chunk) * SLOT_CHUNK);
+		if (!*chunk) {
+			snis_object_pool_free_object(s->pool, n);
+			return -1;
+		}
+	}
+	l = &s->level[level];
+	a = &l->obj[type];
+	i = object_array_append(a);
+	if (i < 0) {
+		snis_object_pool_free_object(s->pool, n);
+		return -1;
+	}
+	a->n[i] = n;
+	a->x[i] = x;
+	a->y[i] = y;
+	a->px[i] = x;
+	a->py[i] = y;
+	a->direction[i] = 0;
+	a->period[i] = default_move_time[type] * WHEEL_HZ;
+	a->moved[i] = 0;
+	slot = object_store_slot(s, n);
+	slot->level = level;
+	slot->type = type;
+	slot->index = i;
+	slot->timer_slot = -1;
+	cell_link(s, l, n, x, y);
+	if (a->period[i] && type_wakes[type])
+		timer_link(s, &l->wheel, n, l->wheel.now + a->period[i]);
+	return n;
+}
+
+static struct object_array *slot_array(struct object_store *s, int n)
+{
+	struct object_slot *slot = object_store_slot(s, n);
+
+	return &s->level[slot->level].obj[slot->type];
+}
+
+void object_store_remove(struct object_store *s, int n)
+{
+	struct level *l;
+	struct object_array *a;
+	int i, last;
+
+	if (n < 0 || n >= s->maxobjs)
+		return;
+	l = &s->level[object_store_slot(s, n)->level];
+	a = slot_array(s, n);
+	i = object_store_slot(s, n)->index;
+	cell_unlink(s, l, n, a->x[i], a->y[i]);
+	timer_unlink(s, &l->wheel, n);
+	last = --a->nobjs;
+	if (i != last) {
+		a->n[i] = a->n[last];
+		a->x[i] = a->x[last];
+		a->y[i] = a->y[last];
+		a->px[i] = a->px[last];
+		a->py[i] = a->py[last];
+		a->direction[i] = a->direction[last];
+		a->period[i] = a->period[last];
+		a->moved[i] = a->moved[last];
+		object_store_slot(s, a->n[i])->index = i;
+	}
+	snis_object_pool_free_object(s->pool, n);
+}
+
+void object_store_set_speed(struct object_store *s, int n,
+				float seconds_per_move)
+{
+	struct object_slot *slot;
+	struct timer_wheel *w;
+	struct object_array *a;
+	float period = seconds_per_move * WHEEL_HZ;
+
+	if (n < 0 || n >= s->maxobjs)
+		return;
+	slot = object_store_slot(s, n);
+	w = &s->level[slot->level].wheel;
+	a = slot_array(s, n);
+	a->period[slot->index] = period < 1.0 ? 1 : period > 65535.0 ? 65535 : period;
+	timer_unlink(s, w, n);
+	if (type_wakes[slot->type])
+		timer_link(s, w, n, w->now + a->period[slot->index]);
+}
+
+struct object_array *object_store_lookup(struct object_store *s, int n,
+					int *index)
+{
+	if (n < 0 || n >= s->maxobjs)
+		return NULL;
+	*index = object_store_slot(s, n)->index;
+	return slot_array(s, n);
+}
+
+snis_handle object_store_handle(struct object_store *s, int n)
+{
+	return snis_object_pool_handle(s->pool, n);
+}
+
+struct object_array *object_store_lookup_handle(struct object_store *s,
+						snis_handle h, int *index)
+{
+	int n = snis_object_pool_handle_to_id(s->pool, h);
+
+	if (n < 0)
+		return NULL;
+	return object_store_lookup(s, n, index);
+}
+
+static int move_level(struct object_store *s, struct level *l, float time)
+{
+	l->wheel.steps++;
+	l->wheel.time += time;
+	return wheel_advance(s, l, (unsigned int) (l->wheel.time * WHEEL_HZ));
+}
+
+/* Bring an unsimulated level up to date in one big tick */
+static void catch_up_level(struct object_store *s, struct level *l)
+{
+	if (s->time <= l->wheel.time)
+		return;
+	move_level(s, l, s->time - l->wheel.time);
+	l->wheel.time = s->time;
+}
+
+int object_store_move_objects(struct object_store *s, float time)
+{
+	struct level *l;
+	int i, cost, fired = 0;
+
+	/* Only the player's level is simulated unless they all are, and
+	 * the rest just fall behind, so a frame costs the same however many
+	 * levels there are.
+	 */
+	s->time += time;
+	if (s->lod.mode == SIM_LOD_FULL)
+		for (i = 0; i < s->nlevels; i++)
+			fired += move_level(s, &s->level[i], time);
+	else
+		fired = move_level(s, &s->level[s->active_level], time);
+	if (s->lod.mode != SIM_LOD_BATCHED)
+		return fired;
+
+	/* Batched levels get to spend as many wakes as the simulated ones
+	 * just did, or one if they did none, so they don't stop altogether
+	 * when nothing's moving where the player is.  Catching a level up wakes
+	 * each robot on it once, so however many levels there are, they all
+	 * cost about as much as the player's, they just get caught up less
+	 * often the more of them there are.
+	 */
+	if (s->batch_credit < BATCH_CREDIT_MAX)
+		s->batch_credit += fired ? fired : 1;
+
+	/* One level looked at per frame, round robin, so the batches
+	 * spread themselves out over successive frames instead of all
+	 * landing on the same one.  One that's due waits for the credit
+	 * rather than being passed over for a cheaper one.
+	 */
+	l = &s->level[s->next_batch_level];
+	if (!l->simulated && s->time - l->wheel.time >= s->lod.batch_interval) {
+		/* a wake per robot, and a look at each turn of the wheel */
+		cost = l->wheel.ntimers +
+			(s->time - l->wheel.time) * WHEEL_HZ / WHEEL_SLOTS;
+		if (s->batch_credit < cost)
+			return fired;
+		s->batch_credit -= cost;
+		catch_up_level(s, l);
+	}
+	s->next_batch_level = (s->next_batch_level + 1) % s->nlevels;
+	return fired;
+}
+
+void object_store_set_lod(struct object_store *s, struct sim_lod *lod)
+{
+	s->lod = *lod;
+	object_store_set_active_level(s, s->active_level);
+}
+
+void object_store_set_active_level(struct object_store *s, int level)
+{
+	struct level *l;
+	int i;
+
+	s->active_level = level;
+	for (i = 0; i < s->nlevels; i++) {
+		l = &s->level[i];
+		l->simulated = s->lod.mode == SIM_LOD_FULL || i == level;
+		if (l->simulated)
+			catch_up_level(s, l);
+	}
+}
+
+void object_store_set_target(struct object_store *s, int level, int x, int y)
+{
+	struct flow_field *f;
+	int i;
+
+	for (i = 0; i < s->nlevels; i++) {
+		f = &s->level[i].flow;
+		if (i != level && f->tx >= 0)
+			flow_field_clear(f);
+	}
+	if (level < 0 || level >= s->nlevels)
+		return;
+	f = &s->level[level].flow;
+	/* made the first time the player sets foot on the level */
+	if (!f->dist && flow_field_setup(f, XDIM, YDIM, ROBOT_HUNT_RADIUS))
+		return;
+	flow_field_update(f, s->level[level].maze, x, y);
+}
+
+/* Robots don't walk into each other, or into the player */
+static inline int robot_blocked(struct level *l, int x, int y)
+{
+	if (x == l->flow.tx && y == l->flow.ty)
+		return 1;
+	return l->cell && object_store_occupied(l, CLASS_ROBOT, x, y);
+}
+
+static void robot_step(struct object_store *s, struct level *l,
+			struct object_array *a, int i)
+{
+	char *maze = l->maze;
+	int nx, ny, dir;
+	int count = 0;
+
+	if (l->flow.tx >= 0 &&
+		flow_field_distance(&l->flow, a->x[i], a->y[i]) != FLOW_FIELD_FAR) {
+		/* within range of the player, head straight for them */
+		dir = flow_field_downhill(&l->flow, a->x[i], a->y[i],
+						a->direction[i]);
+		if (dir < 0)
+			return;
+		a->direction[i] = dir;
+		nx = a->x[i] + xo[dir];
+		ny = a->y[i] + yo[dir];
+		if (!robot_blocked(l, nx, ny))
+			move_object(s, l, a, i, nx, ny);
+		return;
+	}
+	if (l->flow.tx >= 0 && l->runs.run[0]) {
+		/* too far to find the way, but the player's in plain sight */
+		dir = corridor_sees(&l->runs, a->x[i], a->y[i],
+					l->flow.tx, l->flow.ty);
+		if (dir >= 0) {
+			a->direction[i] = dir;
+			nx = a->x[i] + xo[dir];
+			ny = a->y[i] + yo[dir];
+			if (!robot_blocked(l, nx, ny))
+				move_object(s, l, a, i, nx, ny);
+			return;
+		}
+	}
+
+	do {
+		count++;
+
+		if (count > 10)
+			return;
+
+		nx = a->x[i] + xo[a->direction[i]];
+		ny = a->y[i] + yo[a->direction[i]];
+
+		if (!inbounds(nx, ny, XDIM, YDIM)) {
+			a->direction[i] = randomn(&s->rng, 4);
+			continue;
+		}
+
+		if (maze[ny * XDIM + nx] != '#' || robot_blocked(l, nx, ny)) {
+			a->direction[i] = randomn(&s->rng, 4);
+			continue;
+		}
+		break;
+	} while (1);
+	move_object(s, l, a, i, nx, ny);
+}
+
+/* A robot that's been left to wander for steps moves without the player
+ * around: straight on until it hits a wall, then off some other way.  So
+ * rather than replay every step, go a whole run at a time off the
+ * corridor tables.  A couple of runs is as good as any number, robots
+ * having long since forgotten where they started.
+ */
+static void robot_fast_forward(struct object_store *s, struct level *l,
+				struct object_array *a, int i, int steps)
+{
+	int leg, tries, run = 0, dir, x, y;
+
+	for (leg = 0; leg < CATCHUP_LEGS && steps > 0; leg++) {
+		dir = a->direction[i];
+		for (tries = 0; tries < 10; tries++) {
+			run = corridor_run(&l->runs, a->x[i], a->y[i], dir);
+			if (run)
+				break;
+			dir = randomn(&s->rng, 4);
+		}
+		a->direction[i] = dir;
+		if (!run)
+			return;
+		if (run > steps)
+			run = steps;
+		steps -= run;
+		x = a->x[i] + run * xo[dir];
+		y = a->y[i] + run * yo[dir];
+		if (robot_blocked(l, x, y))
+			return;
+		move_object(s, l, a, i, x, y);
+	}
+}
+
+/* a[i]'s move, due being how many of its periods are up: more than one
+ * only when a level gets caught up in one go.
+ */
+static inline void wake_robot(struct object_store *s, struct level *l,
+				struct object_array *a, int i, int due)
+{
+	int j;
+
+	/* remember where it was, for the renderer to interpolate from */
+	a->px[i] = a->x[i];
+	a->py[i] = a->y[i];
+	a->moved[i] = l->wheel.steps;
+
+	if (due > s->lod.max_catchup_moves)
+		due = s->lod.max_catchup_moves;
+	if (due == 1)
+		robot_step(s, l, a, i);
+	else if (l->flow.tx < 0 && l->runs.run[0])
+		robot_fast_forward(s, l, a, i, due);
+	else
+		/* hunting, or no runs to go by: a few real steps will do */
+		for (j = 0; j < due && j < CATCHUP_LEGS; j++)
+			robot_step(s, l, a, i);
+}
+
+/* The robots off a slot that's come due, threaded through timer_next */
+static void wake_robots(struct object_store *s, struct level *l, int first,
+			unsigned int to)
+{
+	struct object_array *a = &l->obj[OBJ_ROBOT];
+	struct object_slot *slot;
+	int n, next, i;
+
+	for (n = first; n >= 0; n = next) {
+		slot = object_store_slot(s, n);
+		next = slot->timer_next;
+		i = slot->index;
+		wake_robot(s, l, a, i, timer_refire(s, l, a, i, to));
+	}
+}
+
+int object_store_check(struct object_store *s)
+{
+	struct object_slot *slot;
+	struct object_array *a;
+	struct level *l;
+	int n, i, j, t, live = 0, stored = 0, waiting, errors = 0;
+
+	snis_object_pool_for_each(s->pool, n) {
+		live++;
+		slot = object_store_slot(s, n);
+		if (slot->level < 0 || slot->level >= s->nlevels ||
+			slot->type >= NOBJTYPES) {
+			errors++;
+			continue;
+		}
+		a = slot_array(s, n);
+		if (slot->index < 0 || slot->index >= a->nobjs ||
+			a->n[slot->index] != n)
+			errors++;
+	}
+	for (i = 0; i < s->nlevels; i++)
+		for (t = 0; t < NOBJTYPES; t++)
+			stored += s->level[i].obj[t].nobjs;
+	if (stored != live)
+		errors += abs(stored - live);
+
+	/* everything that moves waiting on its level's wheel... */
+	for (i = 0; i < s->nlevels; i++) {
+		l = &s->level[i];
+		waiting = 0;
+		for (t = 0; t < NOBJTYPES; t++) {
+			a = &l->obj[t];
+			for (j = 0; j < a->nobjs; j++) {
+				slot = object_store_slot(s, a->n[j]);
+				if (slot->timer_slot >= 0)
+					waiting++;
+				else if (type_wakes[t] && a->period[j])
+					errors++;
+			}
+		}
+		if (waiting != l->wheel.ntimers)
+			errors += abs(waiting - l->wheel.ntimers);
+		for (j = 0; j < WHEEL_LEVELS * WHEEL_SLOTS; j++)
+			if ((l->wheel.slot[j] >= 0) !=
+				(int) ((l->wheel.busy[j / WHEEL_SLOTS] >>
+					(j & (WHEEL_SLOTS - 1))) & 1))
+				errors++;
+	}
+
+	/* ...and in the cell it's listed in */
+	for (i = 0; i < s->nlevels; i++) {
+		l = &s->level[i];
+		if (!l->cell)
+			continue;
+		for (t = 0; t < NOBJTYPES; t++) {
+			a = &l->obj[t];
+			for (j = 0; j < a->nobjs; j++) {
+				n = object_store_first_in_cell(l, a->x[j], a->y[j]);
+				while (n >= 0 && n != a->n[j])
+					n = object_store_next_in_cell(s, n);
+				if (n < 0)
+					errors++;
+			}
+		}
+	}
+	return errors;
+}
+
+/* FNV-1a over where everything is, so two runs can be checked for having
+ * ended up in the same place without comparing every object.
+ */
+static unsigned int checksum_bytes(unsigned int h, const void *p, int len)
+{
+	const unsigned char *b = p;
+	int i;
+
+	for (i = 0; i < len; i++) {
+		h ^= b[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+unsigned int object_store_checksum(struct object_store *s, unsigned int h)
+{
+	struct object_array *a;
+	int i, t;
+
+	for (i = 0; i < s->nlevels; i++) {
+		for (t = 0; t < NOBJTYPES; t++) {
+			a = &s->level[i].obj[t];
+			h = checksum_bytes(h, &a->nobjs, sizeof(a->nobjs));
+			h = checksum_bytes(h, a->n, sizeof(*a->n) * a->nobjs);
+			h = checksum_bytes(h, a->x, sizeof(*a->x) * a->nobjs);
+			h = checksum_bytes(h, a->y, sizeof(*a->y) * a->nobjs);
+			h = checksum_bytes(h, a->direction,
+					sizeof(*a->direction) * a->nobjs);
+		}
+	}
+	return h;
+}
+
+#ifdef OBJECTS_BENCHMARK
+/* Two benchmarks:
+ *
+ * Frame update cost versus objects per level and number of levels.
+ * "flat" is the old way: every object on every level in one array of
+ * structs, each getting an indirect move() call whether it moves or
+ * not.  "all" simulates every level, "active" only the player's level,
+ * "batched" the player's level plus batched ticks for the others.
+ *
+ * Robot update throughput of the old array of structs with a move()
+ * function pointer per object, mixed in with non-moving things as in
+ * the game, and with robots alone, versus a structure of arrays with a
+ * loop per type, every robot's timer advanced every frame.  Then what
+ * the timer wheel, which only wakes robots that are due, costs per move.
+ */
+#include <time.h>
+
+#include "my_point.h"
+
+static unsigned int bench_rng = 1234;
+static float robot_move_time = ROBOT_MOVE_TIME;
+
+struct legacy_object;
+
+typedef void (*legacy_move_function)(struct legacy_object *o, char *maze,
+					float time);
+
+struct legacy_object {
+	int x, y, level, alive, n;
+	void *v;
+	legacy_move_function move;
+	void *draw;
+	float time_since_last_move;
+	int direction;
+};
+
+static void legacy_no_move(__attribute__((unused)) struct legacy_object *o,
+			__attribute__((unused)) char *maze,
+			__attribute__((unused)) float time)
+{
+	return;
+}
+
+static void legacy_robot_move(struct legacy_object *o, char *maze, float time)
+{
+	int nx, ny;
+	int count = 0;
+
+	o->time_since_last_move += time;
+	if (o->time_since_last_move < robot_move_time)
+		return;
+	o->time_since_last_move = 0.0;
+	do {
+		count++;
+		if (count > 10) {
+			nx = o->x;
+			ny = o->y;
+			break;
+		}
+		nx = o->x + xo[o->direction];
+		ny = o->y + yo[o->direction];
+		if (!inbounds(nx, ny, XDIM, YDIM) ||
+			maze[ny * XDIM + nx] != '#') {
+			o->direction = randomn(&bench_rng, 4);
+			continue;
+		}
+		break;
+	} while (1);
+	o->x = nx;
+	o->y = ny;
+}
+
+/* The per-type loop over a structure of arrays, as the store had before
+ * the timer wheel: every timer advanced in one pass, then the robots
+ * whose time has come stepped.
+ */
+static void soa_update_robots(struct object_array *a, float *t, char *maze,
+				float time)
+{
+	int i, nx, ny, count, nobjs = a->nobjs;
+
+	for (i = 0; i < nobjs; i++)
+		t[i] += time;
+	for (i = 0; i < nobjs; i++) {
+		if (t[i] < robot_move_time)
+			continue;
+		t[i] -= robot_move_time;
+		count = 0;
+		do {
+			count++;
+			if (count > 10) {
+				nx = a->x[i];
+				ny = a->y[i];
+				break;
+			}
+			nx = a->x[i] + xo[a->direction[i]];
+			ny = a->y[i] + yo[a->direction[i]];
+			if (!inbounds(nx, ny, XDIM, YDIM) ||
+				maze[ny * XDIM + nx] != '#') {
+				a->direction[i] = randomn(&bench_rng, 4);
+				continue;
+			}
+			break;
+		} while (1);
+		a->x[i] = nx;
+		a->y[i] = ny;
+	}
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#define FRAMES 2000
+
+static void random_spot(char *maze, int *x, int *y)
+{
+	do {
+		*x = randomn(&bench_rng, XDIM);
+		*y = randomn(&bench_rng, YDIM);
+	} while (maze[*y * XDIM + *x] != '#');
+}
+
+/* a third of everything moves, roughly as in the game */
+#define bench_type(j) ((j) % 3 ? OBJ_FIRSTAIDKIT : OBJ_ROBOT)
+
+static void fill(struct object_store *s, struct legacy_object *flat,
+		int level, int nobjs)
+{
+	char *maze = s->level[level].maze;
+	int j, x, y;
+
+	for (j = 0; j < nobjs; j++) {
+		random_spot(maze, &x, &y);
+		object_store_add(s, level, bench_type(j), x, y);
+		memset(&flat[j], 0, sizeof(flat[j]));
+		flat[j].x = x;
+		flat[j].y = y;
+		flat[j].level = level;
+		flat[j].move = bench_type(j) == OBJ_ROBOT ?
+				legacy_robot_move : legacy_no_move;
+	}
+}
+
+static void bench_levels(int nlevels, int perlevel)
+{
+	struct object_store s;
+	struct legacy_object *flat;
+	char **maze;
+	struct sim_lod lod = { SIM_LOD_BATCHED, 5.0, 20 };
+	double t0, tflat, tall, tactive, tbatched;
+	int i, j, f, n;
+
+	n = nlevels * perlevel;
+	maze = malloc(sizeof(*maze) * nlevels);
+	flat = malloc(sizeof(*flat) * n);
+	object_store_setup(&s, nlevels, n);
+	for (i = 0; i < nlevels; i++) {
+		maze[i] = make_maze(XDIM, YDIM, XDIM / 2, YDIM - 2, 0, &bench_rng);
+		object_store_set_maze(&s, i, maze[i]);
+		fill(&s, &flat[i * perlevel], i, perlevel);
+	}
+
+	t0 = now();
+	for (f = 0; f < FRAMES; f++)
+		for (j = 0; j < n; j++)
+			flat[j].move(&flat[j], maze[flat[j].level], 1.0 / 60.0);
+	tflat = now() - t0;
+
+	t0 = now();
+	for (f = 0; f < FRAMES; f++)
+		object_store_move_objects(&s, 1.0 / 60.0);
+	tall = now() - t0;
+
+	lod.mode = SIM_LOD_ON_ARRIVAL;
+	object_store_set_lod(&s, &lod);
+	t0 = now();
+	for (f = 0; f < FRAMES; f++)
+		object_store_move_objects(&s, 1.0 / 60.0);
+	tactive = now() - t0;
+
+	/* everything caught up first, outside the timing */
+	lod.mode = SIM_LOD_FULL;
+	object_store_set_lod(&s, &lod);
+	lod.mode = SIM_LOD_BATCHED;
+	object_store_set_lod(&s, &lod);
+	t0 = now();
+	for (f = 0; f < FRAMES; f++)
+		object_store_move_objects(&s, 1.0 / 60.0);
+	tbatched = now() - t0;
+
+	printf("%7d %9d %10d %12.1f %12.1f %12.1f %12.1f\n", nlevels, perlevel, n,
+		tflat * 1e9 / FRAMES, tall * 1e9 / FRAMES,
+		tactive * 1e9 / FRAMES, tbatched * 1e9 / FRAMES);
+
+	object_store_free(&s);
+	for (i = 0; i < nlevels; i++)
+		free(maze[i]);
+	free(maze);
+	free(flat);
+}
+
+static void bench_layout(int nobjs, double *twheel, long *moves)
+{
+	struct object_store s;
+	struct legacy_object *flat, *robots;
+	char *maze;
+	float *t;
+	double t0, tmixed, trobots, tsoa, updates;
+	int j, f, nrobots = 0;
+
+	flat = malloc(sizeof(*flat) * nobjs);
+	robots = malloc(sizeof(*robots) * nobjs);
+	object_store_setup(&s, 1, nobjs);
+	maze = make_maze(XDIM, YDIM, XDIM / 2, YDIM - 2, 0, &bench_rng);
+	s.level[0].maze = maze;
+	fill(&s, flat, 0, nobjs);
+	for (j = 0; j < nobjs; j++)
+		if (flat[j].move == legacy_robot_move)
+			robots[nrobots++] = flat[j];
+
+	t0 = now();
+	for (f = 0; f < FRAMES; f++)
+		for (j = 0; j < nobjs; j++)
+			flat[j].move(&flat[j], maze, 1.0 / 60.0);
+	tmixed = now() - t0;
+
+	t0 = now();
+	for (f = 0; f < FRAMES; f++)
+		for (j = 0; j < nrobots; j++)
+			robots[j].move(&robots[j], maze, 1.0 / 60.0);
+	trobots = now() - t0;
+
+	t = calloc(nrobots, sizeof(*t));
+	t0 = now();
+	for (f = 0; f < FRAMES; f++)
+		soa_update_robots(&s.level[0].obj[OBJ_ROBOT], t, maze, 1.0 / 60.0);
+	tsoa = now() - t0;
+
+	*moves = 0;
+	t0 = now();
+	for (f = 0; f < FRAMES; f++)
+		*moves += object_store_move_objects(&s, 1.0 / 60.0);
+	*twheel = now() - t0;
+
+	updates = (double) nrobots * FRAMES / 1e6;
+	printf("%10d %10d %14.1f %14.1f %14.1f\n", nobjs, nrobots,
+		updates / tmixed, updates / trobots, updates / tsoa);
+
+	object_store_free(&s);
+	free(maze);
+	free(flat);
+	free(robots);
+	free(t);
+}
+
+int main(__attribute__((unused)) int argc, __attribute__((unused)) char *argv[])
+{
+	int levels[] = { 1, 5, 20, 100 };
+	int perlevel[] = { 50, 500, 5000 };
+	int layout[] = { 1000, 10000, 100000 };
+	double twheel[ARRAY_SIZE(layout)];
+	long moves[ARRAY_SIZE(layout)];
+	unsigned int i, j;
+
+	printf("%7s %9s %10s %12s %12s %12s %12s\n", "levels", "per-level",
+		"objects", "flat ns/fr", "all ns/fr", "active ns/fr",
+		"batched ns/fr");
+	for (i = 0; i < ARRAY_SIZE(levels); i++)
+		for (j = 0; j < ARRAY_SIZE(perlevel); j++)
+			bench_levels(levels[i], perlevel[j]);
+
+	printf("\nrobot updates, millions per second\n");
+	printf("%10s %10s %14s %14s %14s\n", "objects", "robots",
+		"aos+fn mixed", "aos+fn robots", "soa robots");
+	for (i = 0; i < ARRAY_SIZE(layout); i++)
+		bench_layout(layout[i], &twheel[i], &moves[i]);
+
+	printf("\ntimer wheel, robots woken only when due\n");
+	printf("%10s %10s %14s\n", "objects", "moves", "ns/move");
+	for (i = 0; i < ARRAY_SIZE(layout); i++)
+		printf("%10d %10ld %14.1f\n", layout[i], moves[i],
+			moves[i] ? twheel[i] * 1e9 / moves[i] : 0.0);
+	return 0;
+}
+#endif
@@ -0,0 +1,253 @@
+#ifndef OBJECTS_H
+#define OBJECTS_H
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+
+#include "maze.h"
+#include "snis_alloc.h"
+#include "flowfield.h"
+#include "corridor.h"
+
+/* Object types.  Behaviour (how, and whether, a thing moves, what it
+ * looks like) hangs off the type rather than off per-object function
+ * pointers, so updates are one tight loop per type instead of one
+ * indirect call per object.
+ */
+enum object_type {
+	OBJ_ROBOT,
+	OBJ_FIRSTAIDKIT,
+	OBJ_LASERPISTOL,
+	OBJ_GRENADE,
+	OBJ_UP_LADDER,
+	OBJ_DOWN_LADDER,
+	NOBJTYPES,
+};
+
+/* What's in a cell, as far as getting in anyone's way or being picked
+ * up goes.
+ */
+enum object_class {
+	CLASS_ROBOT,
+	CLASS_ITEM,
+	CLASS_LADDER,
+	NCLASSES,
+};
+
+extern const unsigned char object_type_class[NOBJTYPES];
+
+/* A dense, growable structure-of-arrays holding objects of one type:
+ * field f of the i'th object is f[i].  Removal swaps the last object
+ * into the hole, so order is not preserved.
+ */
+struct object_array {
+	int nobjs, size;
+	int *n;				/* object number */
+	short *x, *y;
+	short *px, *py;			/* position before the last tick */
+	unsigned char *direction;
+	unsigned short *period;		/* wheel ticks between moves, 0 if none */
+	unsigned int *moved;		/* level step it last moved on */
+};
+
+/* When things on a level next need to do something, so each step only
+ * looks at what's due rather than at everything.  A hierarchical timing
+ * wheel: WHEEL_LEVELS wheels of WHEEL_SLOTS slots, each slot of each wheel
+ * covering as many ticks as the whole of the wheel below, and whatever's
+ * on a slot coming due getting spread back down a wheel.  Slots hold
+ * lists of object numbers threaded through the slot table.
+ */
+#define WHEEL_HZ 64		/* wheel ticks per second of game time */
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 4		/* so up to 2^24 ticks, about three days, ahead */
+
+struct timer_wheel {
+	double time;		/* game time the level has been moved through */
+	unsigned int now;	/* same, in wheel ticks */
+	unsigned int steps;	/* how many times the level's been moved */
+	int ntimers;
+	int slot[WHEEL_LEVELS * WHEEL_SLOTS];	/* first object, -1 if none */
+	uint64_t busy[WHEEL_LEVELS];	/* a bit per slot with anything on */
+};
+
+/* Objects are stored per level and per type, so the per-frame update
+ * never has to look at anything but the dynamic types on the levels
+ * being simulated, and never at items or ladders.
+ */
+struct level {
+	char *maze;
+	int simulated;		/* if not, its wheel's time lags the store's */
+	struct timer_wheel wheel;
+	struct flow_field flow;	/* toward the player, robots in range hunt by it */
+	struct corridor_runs runs;	/* what can be seen from where */
+	int *cell;		/* first object in each cell, -1 if none */
+	uint64_t *occupied[NCLASSES];	/* a bit per cell with any of that class */
+	struct object_array obj[NOBJTYPES];
+};
+
+/* How levels other than the player's get simulated.  Nobody can see
+ * them, so there's no point stepping them at full fidelity.
+ */
+enum sim_lod_mode {
+	SIM_LOD_FULL,		/* every level stepped every frame */
+	SIM_LOD_BATCHED,	/* off-level objects stepped in big batched ticks */
+	SIM_LOD_ON_ARRIVAL,	/* off-level objects frozen until the player shows up */
+};
+
+struct sim_lod {
+	enum sim_lod_mode mode;
+	float batch_interval;	/* least game time between a level's batched ticks */
+	int max_catchup_moves;	/* max robot moves per batched tick */
+};
+
+/* where object number n currently lives */
+struct object_slot {
+	short level;
+	unsigned char type;
+	int index;
+	int cell_next, cell_prev;	/* others in the same maze cell */
+	int timer_next, timer_prev;	/* others on the same wheel slot */
+	short timer_slot;		/* which, -1 if not waiting on one */
+	unsigned int wake;		/* wheel tick it's due */
+};
+
+/* The slot table comes in chunks, made as object numbers in them are
+ * first handed out, so maxobjs can be generous without costing anything
+ * and growing never copies the table.
+ */
+#define SLOT_CHUNK_SHIFT 12
+#define SLOT_CHUNK (1 << SLOT_CHUNK_SHIFT)
+
+struct object_store {
+	int nlevels;
+	int maxobjs;
+	int active_level;
+	int next_batch_level;
+	int batch_credit;		/* wakes batched ticks may still spend */
+	double time;			/* game time the store's been moved through */
+	struct sim_lod lod;
+	unsigned int rng;		/* random state the robots wander by */
+	struct level *level;
+	struct object_slot **slot;	/* chunks of SLOT_CHUNK */
+	struct snis_object_pool *pool;
+};
+
+/* maxobjs is the most objects there can ever be at once, memory is only
+ * used as they're made.
+ */
+extern int object_store_setup(struct object_store *s, int nlevels, int maxobjs);
+extern void object_store_free(struct object_store *s);
+
+/* Give a level its maze, which the store doesn't own but does keep
+ * sight lines for; change it after with object_store_set_cell() so they
+ * follow.
+ */
+extern int object_store_set_maze(struct object_store *s, int level, char *maze);
+extern void object_store_set_cell(struct object_store *s, int level,
+					int x, int y, char v);
+
+/* Add a new object of the given type at x, y on the given level.
+ * Returns the object number, or -1 if the pool is full.
+ */
+extern int object_store_add(struct object_store *s, int level,
+				enum object_type type, int x, int y);
+extern void object_store_remove(struct object_store *s, int n);
+
+/* How many seconds object n takes over each move, from now on */
+extern void object_store_set_speed(struct object_store *s, int n,
+				float seconds_per_move);
+
+/* Find object number n, returns its array and sets *index to its slot
+ * in that array.  Good until the next add or remove.
+ */
+extern struct object_array *object_store_lookup(struct object_store *s, int n,
+						int *index);
+
+/* For references kept across frames (targets, caches): a handle to
+ * object n, and the same as object_store_lookup() by handle, which
+ * returns NULL once that object has been removed, even if its number has
+ * since gone to something else.
+ */
+extern snis_handle object_store_handle(struct object_store *s, int n);
+extern struct object_array *object_store_lookup_handle(struct object_store *s,
+						snis_handle h, int *index);
+/* Returns how many objects came due on the simulated levels */
+extern int object_store_move_objects(struct object_store *s, float time);
+extern void object_store_set_lod(struct object_store *s, struct sim_lod *lod);
+extern void object_store_set_active_level(struct object_store *s, int level);
+
+/* Robots on the given level within range of x, y hunt their way toward
+ * it, everywhere else they wander.  Cheap to call every tick, the level's
+ * flow field is only redone when x, y changes.
+ */
+extern void object_store_set_target(struct object_store *s, int level,
+					int x, int y);
+
+/* Check every live object number against the arrays and every array
+ * entry against its object number, returns how many are wrong.
+ */
+extern int object_store_check(struct object_store *s);
+
+static inline struct object_slot *object_store_slot(struct object_store *s,
+							int n)
+{
+	return &s->slot[n >> SLOT_CHUNK_SHIFT][n & (SLOT_CHUNK - 1)];
+}
+
+/* Whether a[i] moved on the level's last step, from px, py to x, y */
+static inline int object_moved_last_step(struct level *l,
+					struct object_array *a, int i)
+{
+	return a->moved[i] == l->wheel.steps;
+}
+
+/* What's in cell x, y of a level with a maze: the first object number, or
+ * -1, then each next one, or -1, in no particular order.
+ */
+static inline int object_store_first_in_cell(struct level *l, int x, int y)
+{
+	return l->cell[y * XDIM + x];
+}
+
+static inline int object_store_next_in_cell(struct object_store *s, int n)
+{
+	return object_store_slot(s, n)->cell_next;
+}
+
+/* Is there anything of class c in cell x, y, one bit test */
+static inline int object_store_occupied(struct level *l, enum object_class c,
+					int x, int y)
+{
+	int bit = y * XDIM + x;
+
+	return (l->occupied[c][bit >> 6] >> (bit & 63)) & 1;
+}
+
+/* First object of one of types (a mask of 1 << OBJ_...) in cell x, y of
+ * a level, or -1.
+ */
+extern int object_store_find_in_cell(struct object_store *s, int level,
+					int x, int y, unsigned int types);
+
+/* Fold the position of every object into hash h (start with 2166136261) */
+extern unsigned int object_store_checksum(struct object_store *s, unsigned int h);
+
+#endif
@@ -0,0 +1,98 @@
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "maze.h"
+#include "particles.h"
+
+int particles_setup(struct particles *p, int max)
+{
+	memset(p, 0, sizeof(*p));
+	p->x = malloc(sizeof(*p->x) * max);
+	p->y = malloc(sizeof(*p->y) * max);
+	p->vx = malloc(sizeof(*p->vx) * max);
+	p->vy = malloc(sizeof(*p->vy) * max);
+	p->life = malloc(sizeof(*p->life) * max);
+	if (!p->x || !p->y || !p->vx || !p->vy || !p->life) {
+		particles_free(p);
+		return -1;
+	}
+	p->max = max;
+	p->rng = 1;
+	return 0;
+}
+
+void particles_free(struct particles *p)
+{
+	free(p->x);
+	free(p->y);
+	free(p->vx);
+	free(p->vy);
+	free(p->life);
+	memset(p, 0, sizeof(*p));
+}
+
+void particles_burst(struct particles *p, float x, float y, int count,
+			float speed, float life)
+{
+	float angle, v;
+	int i;
+
+	for (i = 0; i < count && p->n < p->max; i++) {
+		angle = randomn(&p->rng, 360) * M_PI / 180.0;
+		v = speed * (randomn(&p->rng, 100) + 1) / 100.0;
+		p->x[p->n] = x;
+		p->y[p->n] = y;
+		p->vx[p->n] = v * cosf(angle);
+		p->vy[p->n] = v * sinf(angle);
+		p->life[p->n] = life * (randomn(&p->rng, 50) + 51) / 100.0;
+		p->n++;
+	}
+}
+
+void particles_move(struct particles *p, float dt)
+{
+	int i, n = p->n;
+
+	/* one straight pass over each array the compiler can vectorize... */
+	for (i = 0; i < n; i++) {
+		p->x[i] += p->vx[i] * dt;
+		p->y[i] += p->vy[i] * dt;
+		p->life[i] -= dt;
+	}
+
+	/* ...then swap the last one into each hole left by one burning out */
+	for (i = 0; i < n; ) {
+		if (p->life[i] > 0.0) {
+			i++;
+			continue;
+		}
+		n--;
+		p->x[i] = p->x[n];
+		p->y[i] = p->y[n];
+		p->vx[i] = p->vx[n];
+		p->vy[i] = p->vy[n];
+		p->life[i] = p->life[n];
+	}
+	p->n = n;
+}
@@ -0,0 +1,50 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+
+/* Sparks and blast debris.  They only ever get drawn, never collide or
+ * matter to the game, and there can be hundreds at once for a fraction
+ * of a second, so they live in their own fixed size pool, sized to what
+ * the laser can draw in a frame, rather than in the object store.
+ * Screen coordinates, per second velocities.
+ */
+struct particles {
+	int n, max;
+	float *x, *y;
+	float *vx, *vy;
+	float *life;		/* seconds left */
+	unsigned int rng;
+};
+
+extern int particles_setup(struct particles *p, int max);
+extern void particles_free(struct particles *p);
+
+/* count particles flying every which way out of x, y at up to speed,
+ * each lasting up to life seconds.  Any that don't fit are dropped.
+ */
+extern void particles_burst(struct particles *p, float x, float y, int count,
+				float speed, float life);
+
+/* Move everything along dt seconds and drop those that have burnt out */
+extern void particles_move(struct particles *p, float dt);
+
+#endif
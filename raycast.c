@@ -0,0 +1,294 @@
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "maze.h"
+#include "objects.h"
+#include "raycast.h"
+
+/* Which classes any of types (a mask of 1 << OBJ_...) are in */
+static unsigned int classes_of(unsigned int types)
+{
+	unsigned int classes = 0;
+	int t;
+
+	for (t = 0; t < NOBJTYPES; t++)
+		if (types & (1u << t))
+			classes |= 1u << object_type_class[t];
+	return classes;
+}
+
+/* Could anything of classes be in cell x, y: a bit test per class */
+static inline int maybe_in_cell(struct level *l, unsigned int classes,
+				int x, int y)
+{
+	int c;
+
+	for (c = 0; c < NCLASSES; c++)
+		if ((classes & (1u << c)) && object_store_occupied(l, c, x, y))
+			return 1;
+	return 0;
+}
+
+int grid_ray_cast(struct object_store *s, int level, int x, int y,
+			float dx, float dy, int range, unsigned int types,
+			struct ray_hit *hit)
+{
+	struct level *l = &s->level[level];
+	float tmaxx, tmaxy, tdeltax, tdeltay;
+	int stepx, stepy, d;
+	unsigned int classes = classes_of(types);
+
+	hit->x = x;
+	hit->y = y;
+	hit->distance = 0;
+	hit->n = -1;
+	if (!l->cell || !inbounds(x, y, XDIM, YDIM))
+		return 0;
+
+	/* t is how far along dx, dy the ray has gone, tmax where it next
+	 * crosses a cell boundary each way, tdelta how far between them.
+	 */
+	stepx = dx > 0 ? 1 : -1;
+	stepy = dy > 0 ? 1 : -1;
+	tdeltax = dx != 0.0 ? 1.0 / fabsf(dx) : HUGE_VALF;
+	tdeltay = dy != 0.0 ? 1.0 / fabsf(dy) : HUGE_VALF;
+	tmaxx = tdeltax * 0.5;
+	tmaxy = tdeltay * 0.5;
+
+	for (d = 0; d <= range; d++) {
+		if (d > 0) {
+			if (tmaxx < tmaxy) {
+				x += stepx;
+				tmaxx += tdeltax;
+			} else {
+				y += stepy;
+				tmaxy += tdeltay;
+			}
+			if (!inbounds(x, y, XDIM, YDIM) ||
+				l->maze[y * XDIM + x] != '#')
+				return 0;
+			hit->x = x;
+			hit->y = y;
+			hit->distance = d;
+		}
+		if (!maybe_in_cell(l, classes, x, y))
+			continue;
+		hit->n = object_store_find_in_cell(s, level, x, y, types);
+		if (hit->n >= 0)
+			return 1;
+	}
+	return 0;
+}
+
+int grid_area_query(struct object_store *s, int level, int x, int y,
+			int radius, unsigned int types, int *n, int max)
+{
+	struct level *l = &s->level[level];
+	int cx, cy, x1, y1, x2, y2, o, found = 0;
+	unsigned int classes = classes_of(types);
+
+	if (!l->cell)
+		return 0;
+	x1 = x - radius < 0 ? 0 : x - radius;
+	y1 = y - radius < 0 ? 0 : y - radius;
+	x2 = x + radius >= XDIM ? XDIM - 1 : x + radius;
+	y2 = y + radius >= YDIM ? YDIM - 1 : y + radius;
+	for (cy = y1; cy <= y2; cy++) {
+		for (cx = x1; cx <= x2; cx++) {
+			if ((cx - x) * (cx - x) + (cy - y) * (cy - y) >
+				radius * radius)
+				continue;
+			if (!maybe_in_cell(l, classes, cx, cy))
+				continue;
+			for (o = object_store_first_in_cell(l, cx, cy); o >= 0;
+					o = object_store_next_in_cell(s, o)) {
+				if (!(types & (1u << object_store_slot(s, o)->type)))
+					continue;
+				if (found < max)
+					n[found] = o;
+				found++;
+			}
+		}
+	}
+	return found;
+}
+
+#ifdef RAYCAST_BENCHMARK
+/* Queries per second versus robots on a level: laser shots along
+ * random lines from random corridor cells, and grenade blasts of radius
+ * 2, using the per-cell index, and "scan" doing the same by looking
+ * through every robot on the level.
+ */
+#include <time.h>
+
+#include "my_point.h"
+
+#define QUERIES 200000
+#define LASER_RANGE 30
+#define BLAST_RADIUS 2
+
+static unsigned int bench_rng = 1234;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void random_spot(char *maze, int *x, int *y)
+{
+	do {
+		*x = randomn(&bench_rng, XDIM);
+		*y = randomn(&bench_rng, YDIM);
+	} while (maze[*y * XDIM + *x] != '#');
+}
+
+static int scan_cell(struct object_array *a, int x, int y)
+{
+	int i;
+
+	for (i = 0; i < a->nobjs; i++)
+		if (a->x[i] == x && a->y[i] == y)
+			return a->n[i];
+	return -1;
+}
+
+static int scan_ray_cast(struct object_store *s, int x, int y,
+			float dx, float dy, int range)
+{
+	struct object_array *a = &s->level[0].obj[OBJ_ROBOT];
+	char *maze = s->level[0].maze;
+	float fx = x + 0.5, fy = y + 0.5, len;
+	int d, n;
+
+	/* the obvious way: march along the line a cell at a time */
+	len = sqrtf(dx * dx + dy * dy);
+	dx /= len;
+	dy /= len;
+	for (d = 0; d <= range; d++) {
+		x = (int) fx;
+		y = (int) fy;
+		if (!inbounds(x, y, XDIM, YDIM) || maze[y * XDIM + x] != '#')
+			return -1;
+		n = scan_cell(a, x, y);
+		if (n >= 0)
+			return n;
+		fx += dx;
+		fy += dy;
+	}
+	return -1;
+}
+
+static int scan_area_query(struct object_store *s, int x, int y, int radius)
+{
+	struct object_array *a = &s->level[0].obj[OBJ_ROBOT];
+	int i, found = 0;
+
+	for (i = 0; i < a->nobjs; i++)
+		if ((a->x[i] - x) * (a->x[i] - x) +
+			(a->y[i] - y) * (a->y[i] - y) <= radius * radius)
+			found++;
+	return found;
+}
+
+static void bench_density(int nrobots)
+{
+	struct object_store s;
+	struct ray_hit hit;
+	char *maze;
+	float *dx, *dy, angle;
+	int *qx, *qy, i, x, y, q, scan_queries, hits = 0;
+	double t0, tcast, tscancast, tblast, tscanblast;
+	int found[64];
+
+	object_store_setup(&s, 1, nrobots + 1);
+	maze = make_maze(XDIM, YDIM, XDIM / 2, YDIM - 2, 0, &bench_rng);
+	object_store_set_maze(&s, 0, maze);
+	for (i = 0; i < nrobots; i++) {
+		random_spot(maze, &x, &y);
+		object_store_add(&s, 0, OBJ_ROBOT, x, y);
+	}
+	qx = malloc(sizeof(*qx) * QUERIES);
+	qy = malloc(sizeof(*qy) * QUERIES);
+	dx = malloc(sizeof(*dx) * QUERIES);
+	dy = malloc(sizeof(*dy) * QUERIES);
+	for (q = 0; q < QUERIES; q++) {
+		random_spot(maze, &qx[q], &qy[q]);
+		angle = randomn(&bench_rng, 3600) * M_PI / 1800.0;
+		dx[q] = cosf(angle);
+		dy[q] = sinf(angle);
+	}
+	/* scanning gets slow, don't wait all day for it */
+	scan_queries = nrobots > 1000 ? QUERIES / 100 : QUERIES / 10;
+
+	t0 = now();
+	for (q = 0; q < QUERIES; q++)
+		hits += grid_ray_cast(&s, 0, qx[q], qy[q], dx[q], dy[q],
+					LASER_RANGE, 1 << OBJ_ROBOT, &hit);
+	tcast = (now() - t0) / QUERIES;
+
+	t0 = now();
+	for (q = 0; q < scan_queries; q++)
+		hits += scan_ray_cast(&s, qx[q], qy[q], dx[q], dy[q],
+					LASER_RANGE) >= 0;
+	tscancast = (now() - t0) / scan_queries;
+
+	t0 = now();
+	for (q = 0; q < QUERIES; q++)
+		hits += grid_area_query(&s, 0, qx[q], qy[q], BLAST_RADIUS,
+				1 << OBJ_ROBOT, found, ARRAY_SIZE(found));
+	tblast = (now() - t0) / QUERIES;
+
+	t0 = now();
+	for (q = 0; q < scan_queries; q++)
+		hits += scan_area_query(&s, qx[q], qy[q], BLAST_RADIUS);
+	tscanblast = (now() - t0) / scan_queries;
+
+	printf("%8d %10.2f %12.2f %12.2f %12.2f %12.2f   (%d)\n", nrobots,
+		(double) nrobots / (XDIM * YDIM), 1e-6 / tcast, 1e-6 / tscancast,
+		1e-6 / tblast, 1e-6 / tscanblast, hits);
+
+	object_store_free(&s);
+	free(maze);
+	free(qx);
+	free(qy);
+	free(dx);
+	free(dy);
+}
+
+int main(__attribute__((unused)) int argc, __attribute__((unused)) char *argv[])
+{
+	int robots[] = { 10, 100, 1000, 10000, 100000 };
+	unsigned int i;
+
+	printf("millions of queries per second\n");
+	printf("%8s %10s %12s %12s %12s %12s\n", "robots", "per cell",
+		"laser", "laser scan", "blast", "blast scan");
+	for (i = 0; i < ARRAY_SIZE(robots); i++)
+		bench_density(robots[i]);
+	return 0;
+}
+#endif
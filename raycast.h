@@ -0,0 +1,53 @@
+#ifndef RAYCAST_H
+#define RAYCAST_H
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+
+#include "objects.h"
+
+/* Hit tests against the maze and the store's per-cell object index, so
+ * they cost what the ray crosses or the blast covers, not how many
+ * robots there are.  types is a mask of (1 << OBJ_...) to look for.
+ */
+
+struct ray_hit {
+	int x, y;	/* last open cell the ray got to */
+	int distance;	/* cells from the start to x, y */
+	int n;		/* object it hit there, or -1 */
+};
+
+/* Cast from the middle of cell x, y in direction dx, dy (any length) for
+ * up to range cells, stepping cell to cell along the line (a grid DDA)
+ * until it hits a wall or an object in types, the start cell included.
+ * Returns 1 if it hit an object, 0 if not.
+ */
+extern int grid_ray_cast(struct object_store *s, int level, int x, int y,
+			float dx, float dy, int range, unsigned int types,
+			struct ray_hit *hit);
+
+/* Every object in types within radius cells of x, y.  Up to max of their
+ * numbers go in n[], returns how many there were in all, which can be
+ * more than max.
+ */
+extern int grid_area_query(struct object_store *s, int level, int x, int y,
+			int radius, unsigned int types, int *n, int max);
+
+#endif
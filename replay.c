@@ -0,0 +1,224 @@
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "replay.h"
+
+#define REPLAY_MAGIC "MNLR"
+#define REPLAY_VERSION 3
+
+static FILE *recording = NULL;
+static unsigned long last_recorded_tick;
+
+static FILE *replay = NULL;
+static unsigned long next_replay_tick;
+static int next_replay_bits = -1;
+static int have_recorded_checksum = 0;
+static uint32_t recorded_checksum;
+
+static void put_u32(FILE *f, uint32_t v)
+{
+	fputc(v & 0xff, f);
+	fputc((v >> 8) & 0xff, f);
+	fputc((v >> 16) & 0xff, f);
+	fputc((v >> 24) & 0xff, f);
+}
+
+static int get_u32(FILE *f, uint32_t *v)
+{
+	unsigned char b[4];
+
+	if (fread(b, 1, 4, f) != 4)
+		return -1;
+	*v = b[0] | b[1] << 8 | b[2] << 16 | (uint32_t) b[3] << 24;
+	return 0;
+}
+
+static void put_leb128(FILE *f, unsigned long v)
+{
+	while (v >= 0x80) {
+		fputc((v & 0x7f) | 0x80, f);
+		v >>= 7;
+	}
+	fputc(v, f);
+}
+
+static int get_leb128(FILE *f, unsigned long *v)
+{
+	int c, shift = 0;
+
+	*v = 0;
+	do {
+		c = fgetc(f);
+		if (c == EOF || shift > 56)
+			return -1;
+		*v |= (unsigned long) (c & 0x7f) << shift;
+		shift += 7;
+	} while (c & 0x80);
+	return 0;
+}
+
+int recording_start(const char *filename, struct replay_header *h)
+{
+	uint32_t interval;
+
+	recording = fopen(filename, "w");
+	if (!recording)
+		return -1;
+	fwrite(REPLAY_MAGIC, 1, 4, recording);
+	fputc(REPLAY_VERSION, recording);
+	put_u32(recording, h->seed);
+	put_u32(recording, h->sim_hz);
+	put_u32(recording, h->lod_mode);
+	memcpy(&interval, &h->batch_interval, sizeof(interval));
+	put_u32(recording, interval);
+	put_u32(recording, h->max_catchup_moves);
+	put_u32(recording, h->nrobots);
+	last_recorded_tick = 0;
+	return 0;
+}
+
+void recording_input(unsigned long tick, int bits)
+{
+	if (!recording)
+		return;
+	put_leb128(recording, tick - last_recorded_tick);
+	fputc(bits & 0x7f, recording);
+	last_recorded_tick = tick;
+}
+
+void recording_stop(unsigned long tick, uint32_t checksum)
+{
+	if (!recording)
+		return;
+	put_leb128(recording, tick - last_recorded_tick);
+	fputc(REPLAY_END, recording);
+	put_u32(recording, checksum);
+	fclose(recording);
+	recording = NULL;
+}
+
+static void read_next_input(void)
+{
+	unsigned long delta;
+	int c;
+
+	if (get_leb128(replay, &delta) < 0 || (c = fgetc(replay)) == EOF) {
+		/* truncated, say by a crash, just stop here */
+		next_replay_bits = REPLAY_END;
+		return;
+	}
+	next_replay_tick += delta;
+	next_replay_bits = c;
+	if (c == REPLAY_END && get_u32(replay, &recorded_checksum) == 0)
+		have_recorded_checksum = 1;
+}
+
+int replay_open(const char *filename, struct replay_header *h)
+{
+	char magic[4];
+	uint32_t interval;
+
+	replay = fopen(filename, "r");
+	if (!replay)
+		return -1;
+	if (fread(magic, 1, 4, replay) != 4 ||
+		memcmp(magic, REPLAY_MAGIC, 4) != 0 ||
+		fgetc(replay) != REPLAY_VERSION)
+		goto bad;
+	if (get_u32(replay, &h->seed) || get_u32(replay, &h->sim_hz) ||
+		get_u32(replay, &h->lod_mode) || get_u32(replay, &interval) ||
+		get_u32(replay, &h->max_catchup_moves) ||
+		get_u32(replay, &h->nrobots))
+		goto bad;
+	memcpy(&h->batch_interval, &interval, sizeof(interval));
+	next_replay_tick = 0;
+	read_next_input();
+	return 0;
+bad:
+	fclose(replay);
+	replay = NULL;
+	return -1;
+}
+
+int replay_input(unsigned long tick, int *bits)
+{
+	if (!replay)
+		return -1;
+	if (tick < next_replay_tick)
+		return 0;
+	if (next_replay_bits == REPLAY_END)
+		return -1;
+	*bits = next_replay_bits;
+	read_next_input();
+	return 1;
+}
+
+#define MAXCOSTS (1 << 20)
+static float *tick_cost;
+static unsigned long ncosts;
+
+void replay_tick_cost(double seconds)
+{
+	if (!tick_cost) {
+		tick_cost = malloc(sizeof(*tick_cost) * MAXCOSTS);
+		if (!tick_cost)
+			return;
+	}
+	tick_cost[ncosts % MAXCOSTS] = seconds;
+	ncosts++;
+}
+
+static int compare_float(const void *a, const void *b)
+{
+	float fa = *(const float *) a;
+	float fb = *(const float *) b;
+
+	return (fa > fb) - (fa < fb);
+}
+
+void replay_report(FILE *f, unsigned long ticks, uint32_t checksum)
+{
+	unsigned long i, n;
+	double total = 0.0;
+
+	fprintf(f, "replayed %lu ticks, world checksum %08x", ticks, checksum);
+	if (have_recorded_checksum)
+		fprintf(f, ", %s recording\n", checksum == recorded_checksum ?
+				"matches" : "DOES NOT MATCH");
+	else
+		fprintf(f, "\n");
+
+	n = ncosts < MAXCOSTS ? ncosts : MAXCOSTS;
+	if (n == 0)
+		return;
+	for (i = 0; i < n; i++)
+		total += tick_cost[i];
+	qsort(tick_cost, n, sizeof(*tick_cost), compare_float);
+	fprintf(f, "tick cost, microseconds: p50 %.2f p90 %.2f p99 %.2f "
+		"max %.2f mean %.2f, %.0f ticks/sec\n",
+		tick_cost[n / 2] * 1e6, tick_cost[n * 9 / 10] * 1e6,
+		tick_cost[n * 99 / 100] * 1e6, tick_cost[n - 1] * 1e6,
+		total / n * 1e6, n / total);
+}
@@ -0,0 +1,67 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+#include <stdio.h>
+#include <stdint.h>
+
+/* Session recording and replay.  Given the same random seed and the same
+ * settings, the simulation is a pure function of which requested_* flags
+ * are set on which tick, so that is all that gets recorded:
+ *
+ *   header:  "MNLR", version byte, then little endian u32s:
+ *            seed, tick rate, offlevel mode, offlevel interval (float
+ *            bits), catchup moves, robots per level
+ *   input:   LEB128 ticks since the last record, then a byte of flags
+ *   end:     LEB128 ticks since the last record, 0xff, u32 checksum of
+ *            the world at the end
+ *
+ * A ten minute session is a few kilobytes.
+ */
+
+struct replay_header {
+	uint32_t seed;
+	uint32_t sim_hz;
+	uint32_t lod_mode;
+	float batch_interval;
+	uint32_t max_catchup_moves;
+	uint32_t nrobots;
+};
+
+#define REPLAY_END 0xff
+
+extern int recording_start(const char *filename, struct replay_header *h);
+extern void recording_input(unsigned long tick, int bits);
+extern void recording_stop(unsigned long tick, uint32_t checksum);
+
+extern int replay_open(const char *filename, struct replay_header *h);
+
+/* What happens on this tick: returns 1 and sets *bits if the input
+ * changes, 0 if it doesn't, -1 if the recording has ended.  Ticks must
+ * be asked about in order.
+ */
+extern int replay_input(unsigned long tick, int *bits);
+
+/* per tick simulation cost, for comparing builds */
+extern void replay_tick_cost(double seconds);
+extern void replay_report(FILE *f, unsigned long ticks, uint32_t checksum);
+
+#endif
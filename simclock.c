@@ -0,0 +1,79 @@
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+#include <time.h>
+
+#include "simclock.h"
+
+double monotonic_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void sim_clock_init(struct sim_clock *c, int hz)
+{
+	c->tick = 1.0 / hz;
+	c->last = monotonic_time();
+	c->accumulator = 0.0;
+	c->ticks = 0;
+	/* If we fall further behind than this, let the game slow down
+	 * rather than spend ever longer catching up.
+	 */
+	c->max_ticks = hz / 4 + 1;
+}
+
+int sim_clock_ticks_due(struct sim_clock *c)
+{
+	double t;
+	int n;
+
+	t = monotonic_time();
+	c->accumulator += t - c->last;
+	c->last = t;
+	n = (int) (c->accumulator / c->tick);
+	if (n > c->max_ticks) {
+		n = c->max_ticks;
+		c->accumulator = n * c->tick;
+	}
+	c->accumulator -= n * c->tick;
+	return n;
+}
+
+void sim_clock_hold(struct sim_clock *c)
+{
+	c->last = monotonic_time();
+	c->accumulator = 0.0;
+}
+
+float sim_clock_alpha(struct sim_clock *c)
+{
+	return c->accumulator / c->tick;
+}
+
+unsigned long sim_clock_seconds_to_ticks(struct sim_clock *c, double seconds)
+{
+	unsigned long n;
+
+	n = (unsigned long) (seconds / c->tick + 0.5);
+	return n ? n : 1;
+}
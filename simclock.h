@@ -0,0 +1,50 @@
+#ifndef SIMCLOCK_H
+#define SIMCLOCK_H
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+
+/* Fixed timestep simulation clock.  The simulation advances in ticks of
+ * exactly 1/hz seconds no matter how long the laser takes to scan a
+ * frame.  Each frame asks how many ticks are due, runs them, then draws
+ * with sim_clock_alpha() saying how far it is between the last tick and
+ * the next, for interpolating things which moved.
+ */
+struct sim_clock {
+	double tick;		/* seconds per tick */
+	double last;		/* monotonic time of last sim_clock_ticks_due() */
+	double accumulator;	/* real time not yet simulated */
+	unsigned long ticks;	/* ticks simulated so far, counted by the caller */
+	int max_ticks;		/* most ticks run in one frame */
+};
+
+#define DEFAULT_SIM_HZ 30
+
+extern double monotonic_time(void);
+extern void sim_clock_init(struct sim_clock *c, int hz);
+extern int sim_clock_ticks_due(struct sim_clock *c);
+/* while the game isn't running (attract mode), don't bank any time */
+extern void sim_clock_hold(struct sim_clock *c);
+extern float sim_clock_alpha(struct sim_clock *c);
+
+/* convert seconds to a whole number of ticks, at least one */
+extern unsigned long sim_clock_seconds_to_ticks(struct sim_clock *c, double seconds);
+
+#endif
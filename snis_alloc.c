@@ -30,13 +30,43 @@
 
 /* borrowed heavily from Word War vi (wordwarvi.c, http://wordwarvi.sf.net ) */
 
+/* The bitmap is 64 bit words, a set bit meaning that id is in use.  Over
+ * it are two summary bitmaps, one bit per word: "nonfull" says which words
+ * have a free bit in them, "nonempty" which have a used one.  Finding the
+ * lowest free id is then two count-trailing-zeros, after skipping full
+ * summary words (each covers 4096 ids, and nonfull_hint remembers where
+ * the first possibly non-full one is), and finding the new highest id
+ * when the highest is freed is two count-leading-zeros.
+ *
+ * The bitmap comes in chunks of 64 words, one per summary word, made as
+ * they're first needed.  maxobjs is only a limit: a pool that could hold
+ * millions costs a few bytes per 4096 ids until they're used, growing
+ * never copies anything, and ids never change.
+ *
+ * Each chunk also has a generation count per id, for handles.
+ */
+struct pool_chunk {
+	uint64_t word[64];
+	uint32_t generation[64 * 64];
+};
+
 struct snis_object_pool {
-	int nbitblocks;
+	int nchunks;		/* chunks there's room for */
+	int nonfull_hint;	/* no nonfull summary words below this one */
 	int highest_object_number;
+	int highest_is_stale;	/* freed concurrently, work it out when asked */
 	int maxobjs;
-	uint32_t *free_obj_bitmap;
+	struct snis_object_pool_stats stats;
+	struct pool_chunk **chunk;	/* NULL until needed */
+	uint64_t *nonfull;
+	uint64_t *nonempty;
 };
 
+#define WORD(i) ((i) >> 6)
+#define BIT(i) (1ULL << ((i) & 63))
+#define BITMAP(pool, w) ((pool)->chunk[(w) >> 6]->word[(w) & 63])
+#define GENERATION(pool, id) ((pool)->chunk[(id) >> 12]->generation[(id) & 4095])
+
 void snis_object_pool_setup(struct snis_object_pool **pool, int maxobjs)
 {
 	struct snis_object_pool *p;
@@ -44,57 +74,425 @@ void snis_object_pool_setup(struct snis_object_pool **pool, int maxobjs)
 	*pool = malloc(sizeof(**pool));
 	p = *pool;
 	p->maxobjs = maxobjs;
-	p->nbitblocks = ((maxobjs >> 5) + 1);  /* 5, 2^5 = 32, 32 bits per int. */
+	p->nchunks = (maxobjs >> 12) + 1;	/* 2^12 = 4096 ids per chunk */
+	p->nonfull_hint = 0;
 	p->highest_object_number = -1;
-	p->free_obj_bitmap = malloc(sizeof(p->free_obj_bitmap) * p->nbitblocks);
-	memset(p->free_obj_bitmap, 0, sizeof(*p->free_obj_bitmap) * p->nbitblocks);
+	p->highest_is_stale = 0;
+	memset(&p->stats, 0, sizeof(p->stats));
+	p->chunk = calloc(p->nchunks, sizeof(*p->chunk));
+	p->nonfull = calloc(p->nchunks, sizeof(*p->nonfull));
+	p->nonempty = calloc(p->nchunks, sizeof(*p->nonempty));
+}
+
+static int add_chunk(struct snis_object_pool *pool, int c)
+{
+	pool->chunk[c] = calloc(1, sizeof(**pool->chunk));
+	if (!pool->chunk[c])
+		return -1;
+	pool->stats.chunks++;
+	pool->nonfull[c] = ~0ULL;
+	if (c < pool->nonfull_hint)
+		pool->nonfull_hint = c;
+	return 0;
+}
+
+static void count_alloc(struct snis_object_pool *pool)
+{
+	pool->stats.allocs++;
+	if (++pool->stats.live > pool->stats.high_water)
+		pool->stats.high_water = pool->stats.live;
+}
+
+/* word w just had bits set in it */
+static void word_filled(struct snis_object_pool *pool, int w)
+{
+	pool->nonempty[WORD(w)] |= BIT(w);
+	if (BITMAP(pool, w) == ~0ULL)
+		pool->nonfull[WORD(w)] &= ~BIT(w);
 }
 
 int snis_object_pool_use_obj(struct snis_object_pool *pool, int id)
 {
-	if (id < 0 || id > pool->maxobjs)
+	if (id < 0 || id >= pool->maxobjs)
 		return -1;
-        if (pool->free_obj_bitmap[id >> 5] & (1 << (id % 32))) /* bit already set? */
+	if (!pool->chunk[id >> 12] && add_chunk(pool, id >> 12))
+		return -1;
+	if (BITMAP(pool, WORD(id)) & BIT(id)) /* bit already set? */
 		printf("bit already set in snis_object_pool_use_obj, id = %d\n", id);
-        pool->free_obj_bitmap[id >> 5] &= (1 << (id % 32)); /* set the proper bit. */ 
+	BITMAP(pool, WORD(id)) |= BIT(id); /* set the proper bit. */
+	word_filled(pool, WORD(id));
+	if (id > pool->highest_object_number)
+		pool->highest_object_number = id;
+	count_alloc(pool);
 	return id;
 }
 
 int snis_object_pool_alloc_obj(struct snis_object_pool *pool)
+{
+	int s, w, answer;
+
+	for (s = pool->nonfull_hint; s < pool->nchunks; s++)
+		if (pool->nonfull[s])
+			break;
+	pool->stats.scan += s - pool->nonfull_hint + 1;
+	pool->nonfull_hint = s;
+	if (s >= pool->nchunks) {
+		/* everything made so far is full, make another */
+		for (s = 0; s < pool->nchunks; s++)
+			if (!pool->chunk[s])
+				break;
+		if (s >= pool->nchunks || add_chunk(pool, s))
+			return -1;
+	}
+
+	w = (s << 6) + __builtin_ctzll(pool->nonfull[s]);
+	answer = (w << 6) + __builtin_ctzll(~BITMAP(pool, w));
+
+	/* Lowest free id first, so if that's past the end, we're full */
+	if (answer >= pool->maxobjs)
+		return -1;
+	BITMAP(pool, w) |= BIT(answer);
+	word_filled(pool, w);
+	if (answer > pool->highest_object_number)
+		pool->highest_object_number = answer;
+	count_alloc(pool);
+	return answer;
+}
+
+static void find_highest(struct snis_object_pool *pool, int from_chunk)
+{
+	int s, w;
+
+	pool->highest_is_stale = 0;
+	for (s = from_chunk; s >= 0; s--) {
+		if (!pool->nonempty[s])
+			continue;
+		w = (s << 6) + 63 - __builtin_clzll(pool->nonempty[s]);
+		pool->highest_object_number =
+			(w << 6) + 63 - __builtin_clzll(BITMAP(pool, w));
+		return;
+	}
+	pool->highest_object_number = -1;
+}
+
+void snis_object_pool_free_object(struct snis_object_pool *pool, int i)
+{
+	int w = WORD(i);
+
+	BITMAP(pool, w) &= ~BIT(i); /* clear the proper bit. */
+	GENERATION(pool, i)++;
+	pool->stats.frees++;
+	pool->stats.live--;
+	pool->nonfull[WORD(w)] |= BIT(w);
+	if (WORD(w) < pool->nonfull_hint)
+		pool->nonfull_hint = WORD(w);
+	if (!BITMAP(pool, w))
+		pool->nonempty[WORD(w)] &= ~BIT(w);
+	if (i == pool->highest_object_number)
+		find_highest(pool, WORD(w));
+}
+
+int snis_object_pool_highest_object(struct snis_object_pool *pool)
+{
+	if (pool->highest_is_stale)
+		find_highest(pool, pool->nchunks - 1);
+	return pool->highest_object_number;
+}
+
+void snis_object_pool_stats(struct snis_object_pool *pool,
+			struct snis_object_pool_stats *st)
+{
+	*st = pool->stats;
+	st->highest = snis_object_pool_highest_object(pool);
+}
+
+float snis_object_pool_fragmentation(struct snis_object_pool_stats *st)
+{
+	if (st->highest < 0)
+		return 0.0;
+	return 1.0 - (float) st->live / (float) (st->highest + 1);
+}
+
+/* Concurrent versions.  Bits are claimed with an atomic fetch-or and the
+ * summaries kept with atomic or/and, re-checking the word after clearing
+ * a summary bit in case another thread changed it in between (the one
+ * which did will have set the summary bit again before or after, either
+ * way it ends up right).  Chunks are published with a compare and swap.
+ * Each thread keeps its own hint, the word it last found room in, and
+ * starts there, so threads started with different hints mostly work in
+ * different words.  The highest id only ever goes up here; when
+ * it's freed it's marked stale and found again on the next ask.
+ */
+#define load(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)
+
+static int add_chunk_concurrent(struct snis_object_pool *pool, int c)
+{
+	struct pool_chunk *chunk, *expected = NULL;
+
+	chunk = calloc(1, sizeof(*chunk));
+	if (!chunk)
+		return -1;
+	if (!__atomic_compare_exchange_n(&pool->chunk[c], &expected, chunk, 0,
+				__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+		free(chunk);	/* someone else got there first */
+		return 0;
+	}
+	__atomic_add_fetch(&pool->stats.chunks, 1, __ATOMIC_RELAXED);
+	__atomic_or_fetch(&pool->nonfull[c], ~0ULL, __ATOMIC_SEQ_CST);
+	return 0;
+}
+
+static void raise_highest(struct snis_object_pool *pool, int id)
+{
+	int h = load(&pool->highest_object_number);
+
+	while (id > h && !__atomic_compare_exchange_n(&pool->highest_object_number,
+				&h, id, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+		;
+}
+
+/* try to claim a free bit in word w, -1 if there isn't one */
+static int claim_in_word(struct snis_object_pool *pool, int w)
+{
+	uint64_t *wp = &BITMAP(pool, w);
+	uint64_t *nonfull = &pool->nonfull[WORD(w)];
+	uint64_t word, bit;
+
+	while ((word = load(wp)) != ~0ULL) {
+		bit = 1ULL << __builtin_ctzll(~word);
+		if (__atomic_fetch_or(wp, bit, __ATOMIC_SEQ_CST) & bit)
+			continue;	/* lost the race for it */
+		__atomic_or_fetch(&pool->nonempty[WORD(w)], BIT(w), __ATOMIC_SEQ_CST);
+		if ((word | bit) == ~0ULL) {
+			__atomic_and_fetch(nonfull, ~BIT(w), __ATOMIC_SEQ_CST);
+			if (load(wp) != ~0ULL)
+				__atomic_or_fetch(nonfull, BIT(w), __ATOMIC_SEQ_CST);
+		}
+		return (w << 6) + __builtin_ctzll(bit);
+	}
+	return -1;
+}
+
+/* try to claim a free bit in chunk s, -1 if there isn't one */
+static int claim_in_chunk(struct snis_object_pool *pool, int s)
+{
+	uint64_t summary;
+	int w, id;
+
+	while ((summary = load(&pool->nonfull[s]))) {
+		w = (s << 6) + __builtin_ctzll(summary);
+		id = claim_in_word(pool, w);
+		if (id >= 0)
+			return id;
+		/* full, but the summary hadn't caught up yet */
+		__atomic_and_fetch(&pool->nonfull[s], ~BIT(w), __ATOMIC_SEQ_CST);
+		if (load(&BITMAP(pool, w)) != ~0ULL)
+			__atomic_or_fetch(&pool->nonfull[s], BIT(w), __ATOMIC_SEQ_CST);
+	}
+	return -1;
+}
+
+/* The counters are shared, so these cost a contended cache line each.
+ * Cheap next to the summary updates, which are the same.
+ */
+static void count_alloc_concurrent(struct snis_object_pool *pool)
+{
+	int live, hw;
+
+	__atomic_add_fetch(&pool->stats.allocs, 1, __ATOMIC_RELAXED);
+	live = __atomic_add_fetch(&pool->stats.live, 1, __ATOMIC_RELAXED);
+	hw = __atomic_load_n(&pool->stats.high_water, __ATOMIC_RELAXED);
+	while (live > hw && !__atomic_compare_exchange_n(&pool->stats.high_water,
+				&hw, live, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+static int claimed(struct snis_object_pool *pool, int id, int *hint)
+{
+	if (id >= pool->maxobjs) {
+		/* past the end of the last chunk, put it back */
+		count_alloc_concurrent(pool);
+		snis_object_pool_free_object_concurrent(pool, id);
+		return 0;
+	}
+	*hint = WORD(id);
+	raise_highest(pool, id);
+	count_alloc_concurrent(pool);
+	return 1;
+}
+
+int snis_object_pool_alloc_obj_concurrent(struct snis_object_pool *pool,
+						int *hint)
+{
+	int i, s, id;
+
+	/* where this thread last found room, most likely room again */
+	if (*hint < 0 || WORD(*hint) >= pool->nchunks)
+		*hint = 0;
+	__atomic_add_fetch(&pool->stats.scan, 1, __ATOMIC_RELAXED);
+	if (load(&pool->chunk[WORD(*hint)])) {
+		id = claim_in_word(pool, *hint);
+		if (id >= 0 && claimed(pool, id, hint))
+			return id;
+	}
+
+	for (i = 0; i < pool->nchunks; i++) {
+		s = (WORD(*hint) + i) % pool->nchunks;
+		if (!load(&pool->chunk[s]))
+			continue;
+		__atomic_add_fetch(&pool->stats.scan, 1, __ATOMIC_RELAXED);
+		id = claim_in_chunk(pool, s);
+		if (id >= 0 && claimed(pool, id, hint))
+			return id;
+	}
+
+	/* everything made so far is full, make another and try again */
+	for (s = 0; s < pool->nchunks; s++)
+		if (!load(&pool->chunk[s]))
+			break;
+	if (s >= pool->nchunks || add_chunk_concurrent(pool, s))
+		return -1;
+	*hint = s << 6;
+	return snis_object_pool_alloc_obj_concurrent(pool, hint);
+}
+
+void snis_object_pool_free_object_concurrent(struct snis_object_pool *pool, int i)
+{
+	uint64_t *wp = &BITMAP(pool, WORD(i));
+	int s = WORD(WORD(i));
+
+	__atomic_add_fetch(&GENERATION(pool, i), 1, __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&pool->stats.frees, 1, __ATOMIC_RELAXED);
+	__atomic_sub_fetch(&pool->stats.live, 1, __ATOMIC_RELAXED);
+	__atomic_and_fetch(wp, ~BIT(i), __ATOMIC_SEQ_CST);
+	__atomic_or_fetch(&pool->nonfull[s], BIT(WORD(i)), __ATOMIC_SEQ_CST);
+	if (load(wp) == 0) {
+		__atomic_and_fetch(&pool->nonempty[s], ~BIT(WORD(i)),
+					__ATOMIC_SEQ_CST);
+		if (load(wp) != 0)
+			__atomic_or_fetch(&pool->nonempty[s], BIT(WORD(i)),
+					__ATOMIC_SEQ_CST);
+	}
+	if (i == load(&pool->highest_object_number))
+		__atomic_store_n(&pool->highest_is_stale, 1, __ATOMIC_SEQ_CST);
+	/* for the non-concurrent allocator's hint, look from the start next time */
+	if (load(&pool->nonfull_hint))
+		__atomic_store_n(&pool->nonfull_hint, 0, __ATOMIC_SEQ_CST);
+}
+
+snis_handle snis_object_pool_handle(struct snis_object_pool *pool, int id)
+{
+	if (id < 0 || id >= pool->maxobjs || !pool->chunk[id >> 12])
+		return SNIS_NO_HANDLE;
+	return (snis_handle) GENERATION(pool, id) << 32 | (uint32_t) id;
+}
+
+int snis_object_pool_handle_to_id(struct snis_object_pool *pool, snis_handle h)
+{
+	int id = snis_handle_id(h);
+
+	if (id < 0 || id >= pool->maxobjs ||
+		!__atomic_load_n(&pool->chunk[id >> 12], __ATOMIC_ACQUIRE))
+		return -1;
+	if (__atomic_load_n(&GENERATION(pool, id), __ATOMIC_RELAXED) !=
+			(uint32_t) (h >> 32))
+		return -1;
+	if (!(__atomic_load_n(&BITMAP(pool, WORD(id)), __ATOMIC_RELAXED) & BIT(id)))
+		return -1;
+	return id;
+}
+
+int snis_object_pool_next(struct snis_object_pool *pool, int id)
+{
+	uint64_t bits, summary;
+	int w, s;
+
+	id++;
+	if (id > pool->highest_object_number)
+		return -1;
+
+	/* the rest of this word */
+	w = WORD(id);
+	bits = pool->chunk[w >> 6] ? BITMAP(pool, w) & (~0ULL << (id & 63)) : 0;
+	if (bits)
+		return (w << 6) + __builtin_ctzll(bits);
+
+	/* the next word with anything in it */
+	w++;
+	s = WORD(w);
+	summary = pool->nonempty[s] & (~0ULL << (w & 63));
+	while (!summary) {
+		if (++s >= pool->nchunks)
+			return -1;
+		summary = pool->nonempty[s];
+	}
+	w = (s << 6) + __builtin_ctzll(summary);
+	return (w << 6) + __builtin_ctzll(BITMAP(pool, w));
+}
+
+int snis_object_pool_first(struct snis_object_pool *pool)
+{
+	return snis_object_pool_next(pool, -1);
+}
+
+void snis_object_pool_free(struct snis_object_pool *pool)
+{
+	int i;
+
+	for (i = 0; i < pool->nchunks; i++)
+		free(pool->chunk[i]);
+	free(pool->chunk);
+	free(pool->nonfull);
+	free(pool->nonempty);
+}
+
+#ifdef SNIS_ALLOC_BENCHMARK
+/* Alloc/free churn, the old bit-at-a-time 32 bit scan against the
+ * summary bitmap, from 1k to 1M ids.  The pool is filled to 90%, then
+ * each op frees one id and allocates one:
+ *
+ * "lifo" frees the most recently allocated id, as when things are made
+ * and destroyed in quick succession.  The free hole sits at the top of
+ * the pool, which is the worst case for the old linear scan.
+ *
+ * "random" frees an id chosen at random from the live ones.
+ *
+ * Both allocators hand out the lowest free id, so they are run through
+ * the same ops and checked against each other as they go.
+ */
+#include <time.h>
+
+struct legacy_pool {
+	int nbitblocks;
+	int highest_object_number;
+	int maxobjs;
+	uint32_t *free_obj_bitmap;
+};
+
+static void legacy_setup(struct legacy_pool *p, int maxobjs)
+{
+	p->maxobjs = maxobjs;
+	p->nbitblocks = ((maxobjs >> 5) + 1);
+	p->highest_object_number = -1;
+	p->free_obj_bitmap = calloc(p->nbitblocks, sizeof(*p->free_obj_bitmap));
+}
+
+static int legacy_alloc(struct legacy_pool *pool)
 {
 	int i, j, answer;
 	unsigned int block;
 
-	/* this might be optimized by find_first_zero_bit, or whatever */
-	/* it's called that's in the linux kernel.  But, it's pretty */
-	/* fast as is, and this is portable without writing asm code. */
-	/* Er, portable, except for assuming an int is 32 bits. */
-
 	for (i = 0; i < pool->nbitblocks; i++) {
-		if (pool->free_obj_bitmap[i] == 0xffffffff) /* is this block full?  continue. */
+		if (pool->free_obj_bitmap[i] == 0xffffffff)
 			continue;
-
-		/* I tried doing a preliminary binary search using bitmasks to figure */
-		/* which byte in block contains a free slot so that the for loop only */
-		/* compared 8 bits, rather than up to 32.  This resulted in a performance */
-		/* drop, (according to the gprof) perhaps contrary to intuition.  My guess */
-		/* is branch misprediction hurt performance in that case.  Just a guess though. */
-
-		/* undoubtedly the best way to find the first empty bit in an array of ints */
-		/* is some custom ASM code.  But, this is portable, and seems fast enough. */
-		/* profile says we spend about 3.8% of time in here. */
-	
-		/* Not full. There is an empty slot in this block, find it. */
-		block = pool->free_obj_bitmap[i];			
+		block = pool->free_obj_bitmap[i];
 		for (j = 0; j < 32; j++) {
-			if (block & 0x01) {	/* is bit j set? */
+			if (block & 0x01) {
 				block = block >> 1;
-				continue;	/* try the next bit. */
+				continue;
 			}
-
-			/* Found free bit, bit j.  Set it, marking it non free.  */
 			pool->free_obj_bitmap[i] |= (1 << j);
-			answer = (i * 32 + j);	/* return the corresponding array index, if in bounds. */
+			answer = (i * 32 + j);
 			if (answer >= pool->maxobjs)
 				return -1;
 			if (answer > pool->highest_object_number)
@@ -105,14 +503,13 @@ int snis_object_pool_alloc_obj(struct snis_object_pool *pool)
 	return -1;
 }
 
-void snis_object_pool_free_object(struct snis_object_pool *pool, int i)
+static void legacy_free(struct legacy_pool *pool, int i)
 {
 	int j;
 
-        pool->free_obj_bitmap[i >> 5] &= ~(1 << (i % 32)); /* clear the proper bit. */ 
+	pool->free_obj_bitmap[i >> 5] &= ~(1 << (i % 32));
 	if (i != pool->highest_object_number)
 		return;
-
 	for (i = pool->nbitblocks - 1; i >= 0; i--) {
 		if (pool->free_obj_bitmap[i] == 0)
 			continue;
@@ -126,13 +523,339 @@ void snis_object_pool_free_object(struct snis_object_pool *pool, int i)
 	pool->highest_object_number = -1;
 }
 
-int snis_object_pool_highest_object(struct snis_object_pool *pool)
+static double now(void)
 {
-	return pool->highest_object_number;
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
 }
 
-void snis_object_pool_free(struct snis_object_pool *pool)
+#define OPS 20000
+
+/* which live id each op frees, and a check of the ids handed out */
+static int *victim;
+static int *expected;
+
+static void make_ops(int nlive, int lifo, unsigned int seed)
+{
+	int i;
+
+	for (i = 0; i < OPS; i++)
+		victim[i] = lifo ? nlive - 1 : rand_r(&seed) % nlive;
+}
+
+static double churn_legacy(int maxobjs, int *live, int nlive)
+{
+	struct legacy_pool p;
+	double t0, t;
+	int i, id;
+
+	/* filling it by allocating one at a time would take minutes */
+	legacy_setup(&p, maxobjs);
+	for (i = 0; i < nlive; i++) {
+		p.free_obj_bitmap[i >> 5] |= 1U << (i % 32);
+		live[i] = i;
+	}
+	p.highest_object_number = nlive - 1;
+	t0 = now();
+	for (i = 0; i < OPS; i++) {
+		legacy_free(&p, live[victim[i]]);
+		id = legacy_alloc(&p);
+		live[victim[i]] = id;
+		expected[i] = id ^ p.highest_object_number << 20;
+	}
+	t = now() - t0;
+	free(p.free_obj_bitmap);
+	return t;
+}
+
+static double churn(int maxobjs, int *live, int nlive)
+{
+	struct snis_object_pool *p;
+	double t0, t;
+	int i, id, mismatch = 0;
+
+	snis_object_pool_setup(&p, maxobjs);
+	for (i = 0; i < nlive; i++)
+		live[i] = snis_object_pool_alloc_obj(p);
+	t0 = now();
+	for (i = 0; i < OPS; i++) {
+		snis_object_pool_free_object(p, live[victim[i]]);
+		id = snis_object_pool_alloc_obj(p);
+		live[victim[i]] = id;
+		/* kept out of the timed path as far as possible */
+		mismatch |= expected[i] != (id ^ p->highest_object_number << 20);
+	}
+	t = now() - t0;
+	if (mismatch)
+		printf("MISMATCH against the old allocator at %d objects\n",
+			maxobjs);
+	snis_object_pool_free(p);
+	free(p);
+	return t;
+}
+
+/* Walking live ids, against testing every id up to the highest, with a
+ * pool of 1M ids of which the first, and some of the rest, are in use.
+ */
+static void iteration(void)
+{
+	struct snis_object_pool *p;
+	double pct[] = { 0.1, 1.0, 10.0, 90.0 };
+	unsigned int seed = 1234;
+	double t0, tscan, titer;
+	int maxobjs = 1000000;
+	int i, id, count, nscan, niter;
+	unsigned int j;
+
+	printf("walking live ids in a pool of %d, ns per walk\n", maxobjs);
+	printf("%8s %8s %14s %14s\n", "live %", "live", "test every id",
+		"iterator");
+	for (j = 0; j < sizeof(pct) / sizeof(pct[0]); j++) {
+		snis_object_pool_setup(&p, maxobjs);
+		for (i = 0; i < maxobjs; i++)
+			snis_object_pool_alloc_obj(p);
+		/* keep id 0 and the highest, so both walks cover the lot */
+		for (i = 1; i < maxobjs - 1; i++)
+			if (rand_r(&seed) % 1000000 >= pct[j] * 10000)
+				snis_object_pool_free_object(p, i);
+
+		t0 = now();
+		nscan = 0;
+		for (i = 0; i <= snis_object_pool_highest_object(p); i++)
+			if (BITMAP(p, WORD(i)) & BIT(i))
+				nscan++;
+		tscan = now() - t0;
+
+		t0 = now();
+		niter = 0;
+		snis_object_pool_for_each(p, id)
+			niter++;
+		titer = now() - t0;
+
+		count = nscan;
+		if (niter != nscan)
+			printf("MISMATCH, iterator found %d, scan %d\n", niter, nscan);
+		printf("%8.1f %8d %14.0f %14.0f\n", pct[j], count,
+			tscan * 1e9, titer * 1e9);
+		snis_object_pool_free(p);
+		free(p);
+	}
+}
+
+/* Cached handles into a churning pool: every frame some objects go and
+ * new ones take their ids, then every cached handle is checked.  The
+ * ones which went must all be caught, including those whose id has
+ * already been reused.
+ */
+static void handles(void)
+{
+	struct snis_object_pool *p;
+	snis_handle *cache;
+	int *live;
+	char *gone;
+	unsigned int seed = 1234;
+	int maxobjs = 100000, nlive = 90000, ncache = 10000, frames = 100;
+	int i, f, k, id, stale, expected_stale = 0, found_stale = 0, checks = 0;
+	double t0, t = 0.0;
+
+	snis_object_pool_setup(&p, maxobjs);
+	live = malloc(sizeof(*live) * nlive);
+	gone = calloc(ncache, 1);
+	cache = malloc(sizeof(*cache) * ncache);
+	for (i = 0; i < nlive; i++)
+		live[i] = snis_object_pool_alloc_obj(p);
+	for (i = 0; i < ncache; i++)
+		cache[i] = snis_object_pool_handle(p, live[i * (nlive / ncache)]);
+
+	for (f = 0; f < frames; f++) {
+		for (k = 0; k < nlive / 100; k++) {
+			i = rand_r(&seed) % nlive;
+			if (i % (nlive / ncache) == 0 && !gone[i / (nlive / ncache)]) {
+				gone[i / (nlive / ncache)] = 1;
+				expected_stale++;
+			}
+			snis_object_pool_free_object(p, live[i]);
+			live[i] = snis_object_pool_alloc_obj(p);
+		}
+		t0 = now();
+		stale = 0;
+		for (i = 0; i < ncache; i++) {
+			id = snis_object_pool_handle_to_id(p, cache[i]);
+			stale += id < 0;
+		}
+		t += now() - t0;
+		checks += ncache;
+		found_stale = stale;
+	}
+	printf("\n%d cached handles, %d frames of 1%% churn: %d of %d gone "
+		"objects caught, %.1f ns per check\n", ncache, frames,
+		found_stale, expected_stale, t * 1e9 / checks);
+	snis_object_pool_free(p);
+	free(p);
+	free(live);
+	free(gone);
+	free(cache);
+}
+
+/* Threads each allocating a batch of ids then freeing them in a shuffled
+ * order, over and over, through the concurrent calls, and through the
+ * plain calls behind a mutex.  Every id handed out is claimed in an owner
+ * table, so an id given to two threads at once is caught, and at the end
+ * the pool must be empty again.
+ */
+#include <pthread.h>
+
+#define STRESS_IDS 65536
+#define STRESS_BATCH 256
+#define STRESS_ROUNDS 2000
+
+struct stress {
+	struct snis_object_pool *pool;
+	pthread_mutex_t *lock;
+	int *owner;
+	int thread;
+	int errors;
+};
+
+static void *stress_worker(void *arg)
+{
+	struct stress *st = arg;
+	int id[STRESS_BATCH];
+	unsigned int seed = st->thread;
+	int hint = st->thread * 64;
+	int r, i, j, t, expected;
+
+	for (r = 0; r < STRESS_ROUNDS; r++) {
+		for (i = 0; i < STRESS_BATCH; i++) {
+			if (st->lock) {
+				pthread_mutex_lock(st->lock);
+				id[i] = snis_object_pool_alloc_obj(st->pool);
+				pthread_mutex_unlock(st->lock);
+			} else {
+				id[i] = snis_object_pool_alloc_obj_concurrent(st->pool,
+									&hint);
+			}
+			expected = -1;
+			if (id[i] < 0 || !__atomic_compare_exchange_n(&st->owner[id[i]],
+					&expected, st->thread, 0,
+					__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+				st->errors++;
+		}
+		for (i = STRESS_BATCH - 1; i > 0; i--) {
+			j = rand_r(&seed) % (i + 1);
+			t = id[i];
+			id[i] = id[j];
+			id[j] = t;
+		}
+		for (i = 0; i < STRESS_BATCH; i++) {
+			if (id[i] < 0)
+				continue;
+			__atomic_store_n(&st->owner[id[i]], -1, __ATOMIC_SEQ_CST);
+			if (st->lock) {
+				pthread_mutex_lock(st->lock);
+				snis_object_pool_free_object(st->pool, id[i]);
+				pthread_mutex_unlock(st->lock);
+			} else {
+				snis_object_pool_free_object_concurrent(st->pool, id[i]);
+			}
+		}
+	}
+	return NULL;
+}
+
+static double stress_run(int nthreads, int locked, int *errors)
+{
+	struct snis_object_pool *p;
+	pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+	pthread_t thread[64];
+	struct stress st[64];
+	struct snis_object_pool_stats stats;
+	int *owner;
+	double t0, t;
+	int i;
+
+	snis_object_pool_setup(&p, STRESS_IDS);
+	owner = malloc(sizeof(*owner) * STRESS_IDS);
+	for (i = 0; i < STRESS_IDS; i++)
+		owner[i] = -1;
+	t0 = now();
+	for (i = 0; i < nthreads; i++) {
+		st[i].pool = p;
+		st[i].lock = locked ? &lock : NULL;
+		st[i].owner = owner;
+		st[i].thread = i;
+		st[i].errors = 0;
+		pthread_create(&thread[i], NULL, stress_worker, &st[i]);
+	}
+	*errors = 0;
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(thread[i], NULL);
+		*errors += st[i].errors;
+	}
+	t = now() - t0;
+	snis_object_pool_stats(p, &stats);
+	if (snis_object_pool_highest_object(p) != -1 ||
+		snis_object_pool_first(p) != -1 ||
+		stats.live != 0 || stats.allocs != stats.frees)
+		(*errors)++;
+	snis_object_pool_free(p);
+	free(p);
+	free(owner);
+	return t;
+}
+
+static void stress(void)
 {
-	free(pool->free_obj_bitmap);
+	int threads[] = { 1, 2, 4, 8 };
+	double tlocked, tfree, ops;
+	int elocked, efree;
+	unsigned int i;
+
+	printf("\nthreads allocating and freeing at once, millions of "
+		"alloc+free pairs per second\n");
+	printf("%8s %12s %12s %8s\n", "threads", "mutex", "lock-free", "errors");
+	for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++) {
+		ops = (double) threads[i] * STRESS_ROUNDS * STRESS_BATCH / 1e6;
+		tlocked = stress_run(threads[i], 1, &elocked);
+		tfree = stress_run(threads[i], 0, &efree);
+		printf("%8d %12.2f %12.2f %8d\n", threads[i], ops / tlocked,
+			ops / tfree, elocked + efree);
+	}
 }
 
+int main(__attribute__((unused)) int argc, __attribute__((unused)) char *argv[])
+{
+	int sizes[] = { 1000, 10000, 100000, 1000000 };
+	const char *pattern[] = { "lifo", "random" };
+	int *live;
+	double told, tnew;
+	unsigned int i, j;
+	int nlive;
+
+	victim = malloc(sizeof(*victim) * OPS);
+	expected = malloc(sizeof(*expected) * OPS);
+	iteration();
+	printf("\nalloc+free pairs, ns each, pool 90%% full\n");
+	printf("%8s %8s %12s %12s %8s\n", "objects", "pattern", "old ns", "new ns",
+		"speedup");
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		nlive = sizes[i] * 9 / 10;
+		live = malloc(sizeof(*live) * nlive);
+		for (j = 0; j < 2; j++) {
+			make_ops(nlive, j == 0, 1234);
+			told = churn_legacy(sizes[i], live, nlive);
+			tnew = churn(sizes[i], live, nlive);
+			printf("%8d %8s %12.1f %12.1f %7.1fx\n", sizes[i], pattern[j],
+				told * 1e9 / OPS, tnew * 1e9 / OPS, told / tnew);
+		}
+		free(live);
+	}
+	free(victim);
+	free(expected);
+	handles();
+	stress();
+	return 0;
+}
+#endif
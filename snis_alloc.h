@@ -27,13 +27,76 @@
 #define GLOBAL extern
 #endif
 
+#include <stdint.h>
+
 struct snis_object_pool;
 
+/* An id plus the generation of the object holding it, generation in the
+ * top 32 bits.  Every free of an id bumps its generation, so a handle
+ * kept after its object is gone stops resolving instead of quietly
+ * pointing at whatever got the id next.
+ */
+typedef uint64_t snis_handle;
+#define SNIS_NO_HANDLE (~(snis_handle) 0)
+#define snis_handle_id(h) ((int) ((h) & 0xffffffff))
+
 GLOBAL void snis_object_pool_setup(struct snis_object_pool **pool, int maxobjs);
 GLOBAL int snis_object_pool_alloc_obj(struct snis_object_pool *pool);
 GLOBAL int snis_object_pool_use_obj(struct snis_object_pool *pool, int id);
 GLOBAL void snis_object_pool_free_object(struct snis_object_pool *pool, int i);
 GLOBAL int snis_object_pool_highest_object(struct snis_object_pool *pool);
+
+/* Counters, cheap enough to read every frame.  The ever-increasing ones
+ * give rates by taking the difference between two samples.
+ */
+struct snis_object_pool_stats {
+	int live;			/* allocated now */
+	int high_water;			/* most ever allocated at once */
+	int highest;			/* highest allocated id */
+	int chunks;			/* chunks of 4096 ids made */
+	unsigned long allocs, frees;	/* ever */
+	unsigned long scan;		/* summary words looked at by allocs, ever */
+};
+
+GLOBAL void snis_object_pool_stats(struct snis_object_pool *pool,
+				struct snis_object_pool_stats *st);
+
+/* 0 when the live ids are packed in at the bottom, towards 1 as they're
+ * spread thinner under the highest one.
+ */
+GLOBAL float snis_object_pool_fragmentation(struct snis_object_pool_stats *st);
+
+/* For allocating and freeing from several threads at once, without a
+ * lock.  Each thread passes its own hint, which it should start off
+ * somewhere different from the other threads' (say, 64 times its thread
+ * number).  The lowest free id isn't necessarily the one handed out.
+ * Don't mix these with the plain versions while threads are at it, and
+ * ask for the highest object once they're done: the concurrent free
+ * leaves working out a new highest for then.
+ */
+GLOBAL int snis_object_pool_alloc_obj_concurrent(struct snis_object_pool *pool,
+						int *hint);
+GLOBAL void snis_object_pool_free_object_concurrent(struct snis_object_pool *pool,
+						int i);
+
+/* The handle for allocated id, and back: the id if the handle's object
+ * is still there, else -1.  Both O(1).
+ */
+GLOBAL snis_handle snis_object_pool_handle(struct snis_object_pool *pool, int id);
+GLOBAL int snis_object_pool_handle_to_id(struct snis_object_pool *pool,
+					snis_handle h);
+
+/* Walk the allocated ids in increasing order, skipping free ones a word
+ * (or 4096 ids) at a time, so the walk costs what's live rather than what
+ * the pool could hold.  Each returns -1 when there are no more.  Freeing
+ * the current id while walking is fine, allocating isn't.
+ */
+GLOBAL int snis_object_pool_first(struct snis_object_pool *pool);
+GLOBAL int snis_object_pool_next(struct snis_object_pool *pool, int id);
+
+#define snis_object_pool_for_each(pool, id) \
+	for ((id) = snis_object_pool_first(pool); (id) >= 0; \
+		(id) = snis_object_pool_next((pool), (id)))
 GLOBAL void snis_object_pool_free(struct snis_object_pool *pool);
 
 
@@ -0,0 +1,54 @@
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "track.h"
+
+int track_setup(struct track *t, int maxframes, int maxvertices, int ncolors)
+{
+	memset(t, 0, sizeof(*t));
+	t->first = calloc(maxframes + 1, sizeof(*t->first));
+	t->vertex = malloc(sizeof(*t->vertex) * maxvertices);
+	t->color = calloc(ncolors, sizeof(*t->color));
+	if (!t->first || !t->vertex || !t->color) {
+		track_free(t);
+		return -1;
+	}
+	t->maxframes = maxframes;
+	t->maxvertices = maxvertices;
+	t->ncolors = ncolors;
+	return 0;
+}
+
+void track_free(struct track *t)
+{
+	free(t->first);
+	free(t->vertex);
+	free(t->color);
+	memset(t, 0, sizeof(*t));
+}
+
+void track_end_frame(struct track *t)
+{
+	if (t->nframes < t->maxframes)
+		t->first[++t->nframes] = t->nvertices;
+}
@@ -0,0 +1,79 @@
+#ifndef TRACK_H
+#define TRACK_H
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+
+/* A precomputed animation, for the attract sequence and the like: every
+ * frame's vertices, already placed and each lit or blanked, one after
+ * another in a single arena, and a line color per frame, worked out once
+ * and then just replayed by frame number.  Frames and colors loop
+ * separately, so each can be as long as it takes to come back round.
+ */
+struct track_vertex {
+	short x, y;
+	unsigned char lit;
+};
+
+struct track {
+	int nframes, maxframes, ncolors;
+	int *first;		/* frame f is vertex[first[f]] to vertex[first[f + 1] - 1] */
+	struct track_vertex *vertex;
+	int nvertices, maxvertices;
+	int *color;		/* ncolors */
+};
+
+extern int track_setup(struct track *t, int maxframes, int maxvertices,
+			int ncolors);
+extern void track_free(struct track *t);
+
+/* Frames are made in order: vertices, then track_end_frame(), and again.
+ * Vertices past maxvertices are dropped.
+ */
+static inline void track_vertex(struct track *t, int x, int y, int lit)
+{
+	struct track_vertex *v;
+
+	if (t->nvertices >= t->maxvertices)
+		return;
+	v = &t->vertex[t->nvertices++];
+	v->x = x;
+	v->y = y;
+	v->lit = lit;
+}
+
+extern void track_end_frame(struct track *t);
+
+/* Frame n, looping: sets *v to its vertices and returns how many */
+static inline int track_frame(struct track *t, unsigned long n,
+				struct track_vertex **v)
+{
+	int f = n % t->nframes;
+
+	*v = &t->vertex[t->first[f]];
+	return t->first[f + 1] - t->first[f];
+}
+
+static inline int track_color(struct track *t, unsigned long n)
+{
+	return t->color[n % t->ncolors];
+}
+
+#endif
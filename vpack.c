@@ -0,0 +1,389 @@
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "vpack.h"
+
+/* Whether n things of size sz at off lie within a file of size bytes */
+static int in_pack(size_t size, uint32_t off, uint32_t n, size_t sz,
+			size_t align)
+{
+	if (off % align)
+		return 0;
+	return off <= size && (uint64_t) n * sz <= size - off;
+}
+
+static inline int marker(struct my_point_t *p)
+{
+	return p->x == LINE_BREAK || p->x == COLOR_CHANGE;
+}
+
+/* draw_vect() steps over a LINE_BREAK to the point after it and reads on
+ * from there, so the points have to be strokes of two or more, with one
+ * LINE_BREAK between each and the next and no other markers, packs having
+ * no colour.  The stroke table has to say exactly the same.
+ */
+static int check_strokes(struct my_point_t *p, uint32_t npoints,
+			struct vpack_stroke *s, uint32_t nstrokes)
+{
+	uint32_t i, j, next = 0;
+
+	for (i = 0; i < nstrokes; i++) {
+		if (s[i].first != next || s[i].npoints < 2 ||
+			s[i].npoints > npoints - next)
+			return -1;
+		for (j = 0; j < s[i].npoints; j++)
+			if (marker(&p[next + j]))
+				return -1;
+		next += s[i].npoints;
+		if (i == nstrokes - 1)
+			break;
+		if (next >= npoints || p[next].x != LINE_BREAK)
+			return -1;
+		next++;
+	}
+	return next == npoints ? 0 : -1;
+}
+
+static int check_asset(struct vpack *p, struct vpack_asset *a)
+{
+	struct vpack_lod *l;
+	uint32_t i;
+
+	if (memchr(a->name, '\0', VPACK_NAME) == NULL)
+		return -1;
+	if (a->nlods < 1 || a->nlods > VPACK_MAX_LODS)
+		return -1;
+	for (i = 0; i < a->nlods; i++) {
+		l = &a->lod[i];
+		if (l->npoints < 1 || l->nstrokes < 1)
+			return -1;
+		if (!in_pack(p->size, l->points, l->npoints,
+				sizeof(struct my_point_t),
+				__alignof__(struct my_point_t)))
+			return -1;
+		if (!in_pack(p->size, l->strokes, l->nstrokes,
+				sizeof(struct vpack_stroke),
+				__alignof__(struct vpack_stroke)))
+			return -1;
+		if (check_strokes((struct my_point_t *)
+					((char *) p->map + l->points), l->npoints,
+				(struct vpack_stroke *)
+					((char *) p->map + l->strokes),
+				l->nstrokes))
+			return -1;
+	}
+	return 0;
+}
+
+int vpack_open(struct vpack *p, const char *path)
+{
+	struct stat st;
+	uint32_t i;
+	int fd;
+
+	memset(p, 0, sizeof(*p));
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		perror(path);
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+	if ((size_t) st.st_size < sizeof(struct vpack_header)) {
+		fprintf(stderr, "%s: not an asset pack\n", path);
+		close(fd);
+		return -1;
+	}
+	p->size = st.st_size;
+	p->map = mmap(NULL, p->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p->map == MAP_FAILED) {
+		perror(path);
+		p->map = NULL;
+		return -1;
+	}
+	p->header = p->map;
+	p->asset = (struct vpack_asset *) (p->header + 1);
+	if (p->header->magic != VPACK_MAGIC ||
+		p->header->version != VPACK_VERSION) {
+		fprintf(stderr, "%s: not an asset pack this can read\n", path);
+		goto bad;
+	}
+	if (p->header->size != p->size ||
+		!in_pack(p->size, sizeof(struct vpack_header),
+			p->header->nassets, sizeof(struct vpack_asset),
+			__alignof__(struct vpack_asset)))
+		goto damaged;
+	for (i = 0; i < p->header->nassets; i++) {
+		if (check_asset(p, &p->asset[i]))
+			goto damaged;
+		if (i > 0 && strcmp(p->asset[i - 1].name, p->asset[i].name) >= 0)
+			goto damaged;
+	}
+	return 0;
+
+damaged:
+	fprintf(stderr, "%s: asset pack is damaged\n", path);
+bad:
+	vpack_close(p);
+	return -1;
+}
+
+void vpack_close(struct vpack *p)
+{
+	if (p->map)
+		munmap(p->map, p->size);
+	memset(p, 0, sizeof(*p));
+}
+
+struct vpack_asset *vpack_find(struct vpack *p, const char *name)
+{
+	int lo = 0, hi = (int) p->header->nassets - 1, mid, c;
+
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		c = strcmp(name, p->asset[mid].name);
+		if (c == 0)
+			return &p->asset[mid];
+		if (c < 0)
+			hi = mid - 1;
+		else
+			lo = mid + 1;
+	}
+	return NULL;
+}
+
+#ifdef VPACK_CONVERTER
+
+/* Builds a pack out of the art that's compiled into the game:
+ *
+ *	mkvpack assets.vpack
+ */
+
+#include <math.h>
+
+static struct my_point_t robot_points[] =
+#include "robot-vertices.h"
+static struct my_point_t firstaidkit_points[] =
+#include "first-aid-vertices.h"
+static struct my_point_t laserpistol_points[] =
+#include "laser-pistol-vertices.h"
+static struct my_point_t grenade_points[] =
+#include "grenade-vertices.h"
+static struct my_point_t up_ladder_points[] =
+#include "up-ladder-vertices.h"
+static struct my_point_t down_ladder_points[] =
+#include "down-ladder-vertices.h"
+static struct my_point_t logo_points[] =
+#include "logo-vertices.h"
+
+/* sorted by name, as the pack has to be */
+static struct {
+	const char *name;
+	struct my_point_t *p;
+	int npoints;
+} art[] = {
+	{ "down-ladder", down_ladder_points, ARRAY_SIZE(down_ladder_points) },
+	{ "first-aid", firstaidkit_points, ARRAY_SIZE(firstaidkit_points) },
+	{ "grenade", grenade_points, ARRAY_SIZE(grenade_points) },
+	{ "laser-pistol", laserpistol_points, ARRAY_SIZE(laserpistol_points) },
+	{ "logo", logo_points, ARRAY_SIZE(logo_points) },
+	{ "robot", robot_points, ARRAY_SIZE(robot_points) },
+	{ "up-ladder", up_ladder_points, ARRAY_SIZE(up_ladder_points) },
+};
+#define NART ARRAY_SIZE(art)
+
+/* Each lod drops whatever's closer than this fraction of the asset's
+ * size to the line through what's kept either side of it.
+ */
+static const float lod_tolerance[VPACK_MAX_LODS] = {
+	0.0, 1.0 / 64.0, 1.0 / 32.0, 1.0 / 16.0,
+};
+
+static float off_line(struct my_point_t *p, struct my_point_t *a,
+			struct my_point_t *b)
+{
+	float dx = b->x - a->x, dy = b->y - a->y;
+	float len = sqrtf(dx * dx + dy * dy);
+
+	if (len == 0.0)
+		return hypotf(p->x - a->x, p->y - a->y);
+	return fabsf(dx * (a->y - p->y) - dy * (a->x - p->x)) / len;
+}
+
+/* Douglas-Peucker: keep[] what's needed between first and last */
+static void simplify(struct my_point_t *p, int first, int last, float tol,
+			char *keep)
+{
+	int i, worst = -1;
+	float d, dmax = tol;
+
+	for (i = first + 1; i < last; i++) {
+		d = off_line(&p[i], &p[first], &p[last]);
+		if (d > dmax) {
+			dmax = d;
+			worst = i;
+		}
+	}
+	if (worst < 0)
+		return;
+	keep[worst] = 1;
+	simplify(p, first, worst, tol, keep);
+	simplify(p, worst, last, tol, keep);
+}
+
+/* Lod of art in[0..n) simplified to tol, as points with a LINE_BREAK
+ * between strokes, and the strokes.  Returns how many points.
+ */
+static int make_lod(struct my_point_t *in, int n, float tol,
+			struct my_point_t *out, struct vpack_stroke *s,
+			int *nstrokes)
+{
+	char keep[n];
+	int i, start, end, nout = 0;
+
+	*nstrokes = 0;
+	for (start = 0; start < n; start = end + 1) {
+		for (end = start; end < n && in[end].x != LINE_BREAK; end++)
+			;
+		/* a dot draws nothing, and a pack can't hold one */
+		if (end - start < 2)
+			continue;
+		memset(keep + start, tol == 0.0, end - start);
+		keep[start] = keep[end - 1] = 1;
+		if (tol > 0.0)
+			simplify(in, start, end - 1, tol, keep);
+		if (nout) {
+			out[nout].x = LINE_BREAK;
+			out[nout++].y = LINE_BREAK;
+		}
+		s[*nstrokes].first = nout;
+		for (i = start; i < end; i++)
+			if (keep[i])
+				out[nout++] = in[i];
+		s[*nstrokes].npoints = nout - s[*nstrokes].first;
+		(*nstrokes)++;
+	}
+	return nout;
+}
+
+static void pad(FILE *f, long align)
+{
+	while (ftell(f) % align)
+		fputc(0, f);
+}
+
+int main(int argc, char *argv[])
+{
+	struct vpack_header h;
+	struct vpack_asset a[NART];
+	struct vpack_stroke *s;
+	struct my_point_t *out;
+	unsigned int i, j;
+	int k, n, nstrokes, npoints;
+	float size;
+	FILE *f;
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: mkvpack pack-file\n");
+		return 1;
+	}
+	f = fopen(argv[1], "w");
+	if (!f) {
+		perror(argv[1]);
+		return 1;
+	}
+	memset(&h, 0, sizeof(h));
+	memset(a, 0, sizeof(a));
+	fwrite(&h, sizeof(h), 1, f);
+	fwrite(a, sizeof(a), 1, f);
+
+	for (i = 0; i < NART; i++) {
+		strncpy(a[i].name, art[i].name, VPACK_NAME - 1);
+		a[i].minx = a[i].miny = 32767;
+		a[i].maxx = a[i].maxy = -32768;
+		for (k = 0; k < art[i].npoints; k++) {
+			if (art[i].p[k].x == LINE_BREAK)
+				continue;
+			if (art[i].p[k].x < a[i].minx)
+				a[i].minx = art[i].p[k].x;
+			if (art[i].p[k].x > a[i].maxx)
+				a[i].maxx = art[i].p[k].x;
+			if (art[i].p[k].y < a[i].miny)
+				a[i].miny = art[i].p[k].y;
+			if (art[i].p[k].y > a[i].maxy)
+				a[i].maxy = art[i].p[k].y;
+		}
+		size = hypotf(a[i].maxx - a[i].minx, a[i].maxy - a[i].miny);
+
+		out = malloc(sizeof(*out) * art[i].npoints);
+		s = malloc(sizeof(*s) * art[i].npoints);
+		npoints = 0;
+		for (j = 0; j < VPACK_MAX_LODS; j++) {
+			n = make_lod(art[i].p, art[i].npoints,
+				size * lod_tolerance[j], out, s, &nstrokes);
+			if (j == 0 && n == art[i].npoints)
+				/* as drawn from the array, markers and all */
+				memcpy(out, art[i].p, sizeof(*out) * n);
+			else if (j > 0 && n >= npoints)
+				break;
+			npoints = n;
+			pad(f, __alignof__(struct my_point_t));
+			a[i].lod[j].npoints = n;
+			a[i].lod[j].points = ftell(f);
+			fwrite(out, sizeof(*out), n, f);
+			pad(f, __alignof__(struct vpack_stroke));
+			a[i].lod[j].nstrokes = nstrokes;
+			a[i].lod[j].strokes = ftell(f);
+			fwrite(s, sizeof(*s), nstrokes, f);
+			a[i].nlods++;
+		}
+		printf("%s: %d..%d x %d..%d,", a[i].name, a[i].minx, a[i].maxx,
+			a[i].miny, a[i].maxy);
+		for (j = 0; j < a[i].nlods; j++)
+			printf(" %u", a[i].lod[j].npoints);
+		printf(" points\n");
+		free(out);
+		free(s);
+	}
+
+	h.magic = VPACK_MAGIC;
+	h.version = VPACK_VERSION;
+	h.size = ftell(f);
+	h.nassets = NART;
+	rewind(f);
+	fwrite(&h, sizeof(h), 1, f);
+	fwrite(a, sizeof(a), 1, f);
+	if (fclose(f)) {
+		perror(argv[1]);
+		return 1;
+	}
+	return 0;
+}
+
+#endif
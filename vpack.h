@@ -0,0 +1,104 @@
+#ifndef VPACK_H
+#define VPACK_H
+/*
+    (C) Copyright 2013, Stephen M. Cameron.
+
+    This file is part of mazers-n-lasers.
+
+    mazers-n-lasers is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    mazers-n-lasers is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with mazers-n-lasers; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "my_point.h"
+
+/* A pack of vector art, loaded at run time rather than compiled in.
+ * Each asset has a name, a bounding box, and up to VPACK_MAX_LODS
+ * versions with fewer and fewer points for drawing smaller.  Each
+ * version's points are laid out just as draw_vect() wants them, strokes
+ * split by LINE_BREAK, with where each stroke starts and ends alongside,
+ * so the pack is mapped in and drawn straight out of, nothing copied or
+ * parsed.  Everything's native byte order, offsets are from the start of
+ * the file, and the assets are sorted by name.
+ */
+#define VPACK_MAGIC 0x4b50564d	/* "MVPK" */
+#define VPACK_VERSION 1
+#define VPACK_NAME 24
+#define VPACK_MAX_LODS 4
+
+struct vpack_stroke {
+	uint32_t first, npoints;	/* in the lod's points */
+};
+
+struct vpack_lod {
+	uint32_t npoints, points;	/* how many, and where, struct my_point_t */
+	uint32_t nstrokes, strokes;	/* struct vpack_stroke */
+};
+
+struct vpack_asset {
+	char name[VPACK_NAME];
+	int16_t minx, miny, maxx, maxy;
+	uint32_t nlods;
+	struct vpack_lod lod[VPACK_MAX_LODS];	/* most detailed first */
+};
+
+struct vpack_header {
+	uint32_t magic, version;
+	uint32_t size;			/* of the whole file */
+	uint32_t nassets;		/* struct vpack_asset, right after */
+};
+
+struct vpack {
+	void *map;
+	size_t size;
+	struct vpack_header *header;
+	struct vpack_asset *asset;
+};
+
+/* Map in a pack and check it over: nothing in it can point outside it,
+ * and every lod's points are strokes draw_vect() can draw without reading
+ * past them, just as its stroke table says.  Returns -1, having said why,
+ * if it's not a pack or is damaged.
+ */
+extern int vpack_open(struct vpack *p, const char *path);
+extern void vpack_close(struct vpack *p);
+
+/* The named asset, or NULL */
+extern struct vpack_asset *vpack_find(struct vpack *p, const char *name);
+
+/* Lod n of asset a, as something draw_vect() can draw, pointing into the
+ * pack.  Past the least detailed lod gets that.
+ */
+static inline void vpack_vect(struct vpack *p, struct vpack_asset *a, int n,
+				struct my_vect_obj *v)
+{
+	if (n >= (int) a->nlods)
+		n = a->nlods - 1;
+	v->npoints = a->lod[n].npoints;
+	v->p = (struct my_point_t *) ((char *) p->map + a->lod[n].points);
+}
+
+static inline struct vpack_stroke *vpack_strokes(struct vpack *p,
+				struct vpack_asset *a, int n, int *nstrokes)
+{
+	if (n >= (int) a->nlods)
+		n = a->nlods - 1;
+	*nstrokes = a->lod[n].nstrokes;
+	return (struct vpack_stroke *) ((char *) p->map + a->lod[n].strokes);
+}
+
+#endif